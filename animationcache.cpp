@@ -0,0 +1,212 @@
+#include "animationcache.h"
+#include "oledrenderer.h"
+#include "ssd1306driver.h"
+
+namespace {
+// longest period that is detected automatically
+const int MAX_PERIOD_FRAMES = 256;
+}
+
+AnimationCache::AnimationCache(OledRenderer *renderer, Ssd1306Driver *driver, QObject *parent)
+    : QObject(parent)
+    , m_renderer(renderer)
+    , m_driver(driver)
+    , m_state(Detecting)
+    , m_minPeriod(1)
+    , m_maxPeriod(1)
+    , m_lockFrames(0)
+    , m_checkFrames(0)
+    , m_frames(0)
+    , m_period(0)
+    , m_position(0)
+    , m_untilCheck(0)
+    , m_replayed(0)
+    , m_checks(0)
+    , m_invalidated(0)
+{
+    connect(m_renderer, &OledRenderer::imageRendered, this, &AnimationCache::frameRendered);
+    connect(m_renderer, &OledRenderer::frameSkipped, this, &AnimationCache::frameSkipped);
+}
+
+void AnimationCache::start(int fps, int periodMs)
+{
+    fps = qMax(1, fps);
+    if (periodMs > 0) {
+        // the renderer steps the animations by whole milliseconds
+        const int stepMs = qMax(1, 1000 / fps);
+        m_minPeriod = qMax(1, (periodMs + stepMs / 2) / stepMs);
+        m_maxPeriod = m_minPeriod;
+        m_lockFrames = 0;
+    } else {
+        // a scene has to repeat for a second before it is trusted, which keeps slowly
+        // changing content such as a clock from being taken for a static scene
+        m_minPeriod = 1;
+        m_maxPeriod = qMin(MAX_PERIOD_FRAMES, fps * 10);
+        m_lockFrames = fps;
+    }
+    m_checkFrames = fps;
+
+    m_history.fill(0, m_maxPeriod + 1);
+    m_runs.fill(0, m_maxPeriod + 1);
+    invalidate();
+    m_invalidated = 0;
+}
+
+AnimationCache::State AnimationCache::state() const
+{
+    return m_state;
+}
+
+int AnimationCache::period() const
+{
+    return m_period;
+}
+
+QString AnimationCache::summary() const
+{
+    static const char *const states[] = {"detecting", "recording", "replaying"};
+    return QString("cache: %1 period=%2 replayed=%3 checks=%4 invalidated=%5")
+            .arg(states[m_state])
+            .arg(m_period)
+            .arg(m_replayed)
+            .arg(m_checks)
+            .arg(m_invalidated);
+}
+
+void AnimationCache::invalidate()
+{
+    if (m_state != Detecting) {
+        ++m_invalidated;
+    }
+    m_state = Detecting;
+    m_period = 0;
+    m_frames = 0;
+    m_runs.fill(0);
+    m_renderer->setRenderingPaused(false, OledRenderer::CachePause);
+}
+
+void AnimationCache::frameRendered(const QImage &image, const QRect &damage)
+{
+    m_driver->writeImage(image, damage);
+    const quint64 hash = ramHash();
+
+    switch (m_state) {
+    case Detecting: {
+        const int period = updateHistory(hash);
+        if (period > 0) {
+            startRecording(period);
+        }
+        break;
+    }
+    case Recording:
+        record(hash);
+        break;
+    case Replaying:
+        // a spot check, the rendered frame has to match the one the cache would have sent
+        if (hash != m_entries.at(m_position).hash) {
+            invalidate();
+            break;
+        }
+        ++m_checks;
+        m_position = (m_position + 1) % m_period;
+        m_untilCheck = qMax(m_period, m_checkFrames) + 1;
+        m_renderer->setRenderingPaused(true, OledRenderer::CachePause);
+        break;
+    }
+}
+
+void AnimationCache::frameSkipped()
+{
+    if (m_state != Replaying) {
+        return;
+    }
+
+    const Entry &entry = m_entries.at(m_position);
+    m_driver->writeRam(entry.ram.constData(), entry.startLine, entry.plan);
+    ++m_replayed;
+    m_position = (m_position + 1) % m_period;
+
+    // one more than the period moves the checked frame through the cycle
+    if (--m_untilCheck <= 0) {
+        m_renderer->setRenderingPaused(false, OledRenderer::CachePause);
+    }
+}
+
+quint64 AnimationCache::ramHash() const
+{
+    // FNV-1a over the GDDRAM image and the start line it is shown at
+    const QVector<uint8_t> &ram = m_driver->ram();
+    quint64 hash = 14695981039346656037ULL;
+    for (int i = 0; i < ram.size(); ++i) {
+        hash = (hash ^ ram.at(i)) * 1099511628211ULL;
+    }
+    return (hash ^ static_cast<quint64>(m_driver->startLine())) * 1099511628211ULL;
+}
+
+int AnimationCache::updateHistory(quint64 hash)
+{
+    const int size = m_history.size();
+    m_history[static_cast<int>(m_frames % size)] = hash;
+
+    int found = 0;
+    for (int period = m_minPeriod; period <= m_maxPeriod; ++period) {
+        if ((m_frames >= period) && (m_history.at(static_cast<int>((m_frames - period) % size)) == hash)) {
+            ++m_runs[period];
+        } else {
+            m_runs[period] = 0;
+        }
+        if ((found == 0) && (m_runs.at(period) >= qMax(period, m_lockFrames))) {
+            found = period;
+        }
+    }
+
+    ++m_frames;
+    return found;
+}
+
+void AnimationCache::startRecording(int period)
+{
+    m_state = Recording;
+    m_period = period;
+    m_position = 0;
+    m_entries.resize(period);
+}
+
+void AnimationCache::record(quint64 hash)
+{
+    // the cycle being recorded still has to repeat the previous one
+    updateHistory(hash);
+    if (m_runs.at(m_period) == 0) {
+        m_state = Detecting;
+        m_period = 0;
+        return;
+    }
+
+    Entry &entry = m_entries[m_position];
+    entry.hash = hash;
+    entry.startLine = m_driver->startLine();
+    entry.ram = m_driver->ram();
+    entry.ram.detach();
+
+    if (++m_position == m_period) {
+        startReplaying();
+    }
+}
+
+void AnimationCache::startReplaying()
+{
+    // Replay starts right after the last recorded frame, so the first entry is planned against
+    // the last one and the addressing mode follows the mode the driver ended up in.
+    TransferPlan::Mode mode = m_driver->mode();
+    for (int i = 0; i < m_period; ++i) {
+        const Entry &previous = m_entries.at((i + m_period - 1) % m_period);
+        Entry &entry = m_entries[i];
+        entry.plan = m_driver->planTransfer(previous.ram.constData(), entry.ram.constData(), mode);
+        mode = entry.plan.mode;
+    }
+
+    m_state = Replaying;
+    m_position = 0;
+    m_untilCheck = qMax(m_period, m_checkFrames) + 1;
+    m_renderer->setRenderingPaused(true, OledRenderer::CachePause);
+}
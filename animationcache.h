@@ -0,0 +1,84 @@
+#ifndef ANIMATIONCACHE_H
+#define ANIMATIONCACHE_H
+
+#include <QImage>
+#include <QObject>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include <stdint.h>
+#include "transferplanner.h"
+
+class OledRenderer;
+class Ssd1306Driver;
+
+// Replays looping scenes without rendering them. The animation driver advances in fixed
+// steps, so a periodic scene produces the same GDDRAM content in every cycle. Once a period
+// has been seen to repeat, one cycle is recorded as GDDRAM images with the transfer plan from
+// the previous image, and rendering is paused while the cycle is replayed. One frame is
+// rendered now and then to check that the scene still follows the cache.
+class AnimationCache : public QObject
+{
+    Q_OBJECT
+public:
+    enum State {
+        Detecting,
+        Recording,
+        Replaying
+    };
+
+    AnimationCache(OledRenderer *renderer, Ssd1306Driver *driver, QObject *parent = 0);
+
+    // a periodMs of 0 detects the period from the rendered frames
+    void start(int fps, int periodMs = 0);
+
+    State state() const;
+    int period() const;
+    QString summary() const;
+
+public slots:
+    void invalidate();
+
+private slots:
+    void frameRendered(const QImage &image, const QRect &damage);
+    void frameSkipped();
+
+private:
+    struct Entry
+    {
+        quint64 hash;
+        int startLine;
+        TransferPlan plan;
+        QVector<uint8_t> ram;
+    };
+
+    quint64 ramHash() const;
+    int updateHistory(quint64 hash); // returns the shortest period that repeated long enough
+    void startRecording(int period);
+    void record(quint64 hash);
+    void startReplaying();
+
+    OledRenderer *m_renderer;
+    Ssd1306Driver *m_driver;
+    State m_state;
+
+    int m_minPeriod;
+    int m_maxPeriod;
+    int m_lockFrames;
+    int m_checkFrames;
+
+    QVector<quint64> m_history; // frame hashes, indexed by frame number modulo its size
+    QVector<int> m_runs;        // consecutive frames equal to the frame one candidate period earlier
+    qint64 m_frames;
+
+    QVector<Entry> m_entries;
+    int m_period;
+    int m_position;
+    int m_untilCheck;
+
+    quint64 m_replayed;
+    quint64 m_checks;
+    quint64 m_invalidated;
+};
+
+#endif // ANIMATIONCACHE_H
@@ -1,5 +1,7 @@
 #include "animationdriver.h"
 
+#include "frametracer.h"
+
 AnimationDriver::AnimationDriver(int msPerStep)
     : m_step(msPerStep)
     , m_elapsed(0)
@@ -7,8 +9,14 @@ AnimationDriver::AnimationDriver(int msPerStep)
 
 }
 
+void AnimationDriver::setStep(int msPerStep)
+{
+    m_step = msPerStep;
+}
+
 void AnimationDriver::advance()
 {
+    TraceSpan span("animation advance");
     m_elapsed += m_step;
     advanceAnimation();
 }
@@ -8,6 +8,8 @@ class AnimationDriver : public QAnimationDriver
 public:
     AnimationDriver(int msPerStep);
 
+    void setStep(int msPerStep);
+
     void advance() override;
     qint64 elapsed() const override;
 
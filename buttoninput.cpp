@@ -0,0 +1,245 @@
+#include "buttoninput.h"
+
+#include <QDebug>
+#include <QKeySequence>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include "framestatistics.h"
+
+namespace {
+int parseKey(const QString &name)
+{
+    const QKeySequence sequence = QKeySequence::fromString(name.trimmed());
+    if (sequence.count() != 1) {
+        return 0;
+    }
+    return sequence[0] & ~Qt::KeyboardModifierMask;
+}
+}
+
+ButtonInput::ButtonInput(QObject *parent)
+    : QObject(parent)
+    , m_activeLow(false)
+    , m_debounceMs(0)
+    , m_mockFile(-1)
+    , m_mockNotifier(nullptr)
+    , m_edges(0)
+{
+
+}
+
+ButtonInput::~ButtonInput()
+{
+    close();
+    qDeleteAll(m_chips);
+}
+
+bool ButtonInput::parseButton(const QString &spec, QString *chip, int *line, int *key)
+{
+    const int equals = spec.lastIndexOf('=');
+    const int colon = spec.lastIndexOf(':', equals);
+    if ((equals < 0) || (colon <= 0)) {
+        return false;
+    }
+
+    bool ok = false;
+    *line = spec.mid(colon + 1, equals - colon - 1).toInt(&ok);
+    *key = parseKey(spec.mid(equals + 1));
+    *chip = spec.left(colon);
+    if (!chip->contains('/')) {
+        *chip = "/dev/" + *chip;
+    }
+    return ok && (*line >= 0) && (*key != 0);
+}
+
+bool ButtonInput::addButton(const QString &spec)
+{
+    QString path;
+    int line = 0;
+    int key = 0;
+    if (!parseButton(spec, &path, &line, &key)) {
+        return false;
+    }
+
+    Chip *chip = nullptr;
+    for (Chip *existing : m_chips) {
+        if (existing->path == path) {
+            chip = existing;
+        }
+    }
+    if (chip == nullptr) {
+        chip = new Chip;
+        chip->path = path;
+        chip->fd = -1;
+        chip->notifier = nullptr;
+        m_chips.append(chip);
+    }
+    if (chip->lines.contains(line) || (chip->lines.size() >= GPIO_V2_LINES_MAX)) {
+        return false;
+    }
+    chip->lines.append(line);
+    chip->keys.append(key);
+    return true;
+}
+
+void ButtonInput::setActiveLow(bool activeLow)
+{
+    m_activeLow = activeLow;
+}
+
+void ButtonInput::setDebounce(int ms)
+{
+    m_debounceMs = ms;
+}
+
+bool ButtonInput::open()
+{
+    for (Chip *chip : m_chips) {
+        if ((chip->fd < 0) && !requestLines(chip)) {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ButtonInput::requestLines(Chip *chip)
+{
+    const QByteArray path = chip->path.toLocal8Bit();
+    const int chipFile = ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+    if (chipFile < 0) {
+        qWarning() << "cannot open" << chip->path << strerror(errno);
+        return false;
+    }
+
+    gpio_v2_line_request request;
+    memset(&request, 0, sizeof(request));
+    for (int i = 0; i < chip->lines.size(); ++i) {
+        request.offsets[i] = static_cast<__u32>(chip->lines.at(i));
+    }
+    request.num_lines = static_cast<__u32>(chip->lines.size());
+    strncpy(request.consumer, "qml-oled-renderer", sizeof(request.consumer) - 1);
+    // edges are reported for the logical value, a press is always a rising edge
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    if (m_activeLow) {
+        request.config.flags |= GPIO_V2_LINE_FLAG_ACTIVE_LOW;
+    }
+    if (m_debounceMs > 0) {
+        request.config.num_attrs = 1;
+        request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+        request.config.attrs[0].attr.debounce_period_us = static_cast<__u32>(m_debounceMs * 1000);
+        request.config.attrs[0].mask = (request.num_lines == 64) ? ~0ULL : ((1ULL << request.num_lines) - 1);
+    }
+
+    const int res = ioctl(chipFile, GPIO_V2_GET_LINE_IOCTL, &request);
+    const int error = errno;
+    ::close(chipFile);
+    if (res < 0) {
+        qWarning() << "cannot request the button lines of" << chip->path << strerror(error);
+        return false;
+    }
+
+    chip->fd = request.fd;
+    fcntl(chip->fd, F_SETFL, fcntl(chip->fd, F_GETFL) | O_NONBLOCK);
+    chip->notifier = new QSocketNotifier(chip->fd, QSocketNotifier::Read, this);
+    connect(chip->notifier, &QSocketNotifier::activated, this, [this, chip]() { readEvents(chip); });
+    return true;
+}
+
+bool ButtonInput::openMock(const QString &fileName)
+{
+    // opened for writing as well, so a FIFO does not report end of file when a writer is done
+    const QByteArray path = fileName.toLocal8Bit();
+    m_mockFile = ::open(path.constData(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (m_mockFile < 0) {
+        m_mockFile = ::open(path.constData(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    }
+    if (m_mockFile < 0) {
+        qWarning() << "cannot open" << fileName << strerror(errno);
+        return false;
+    }
+    m_mockNotifier = new QSocketNotifier(m_mockFile, QSocketNotifier::Read, this);
+    connect(m_mockNotifier, &QSocketNotifier::activated, this, [this]() { readMock(); });
+    return true;
+}
+
+void ButtonInput::close()
+{
+    for (Chip *chip : m_chips) {
+        delete chip->notifier;
+        chip->notifier = nullptr;
+        if (chip->fd >= 0) {
+            ::close(chip->fd);
+            chip->fd = -1;
+        }
+    }
+    delete m_mockNotifier;
+    m_mockNotifier = nullptr;
+    if (m_mockFile >= 0) {
+        ::close(m_mockFile);
+        m_mockFile = -1;
+    }
+}
+
+quint64 ButtonInput::edges() const
+{
+    return m_edges;
+}
+
+void ButtonInput::readEvents(Chip *chip)
+{
+    gpio_v2_line_event events[16];
+    const ssize_t res = read(chip->fd, events, sizeof(events));
+    if (res < 0) {
+        if (errno != EAGAIN) {
+            qWarning() << "cannot read button events from" << chip->path << strerror(errno);
+        }
+        return;
+    }
+
+    const int count = static_cast<int>(static_cast<size_t>(res) / sizeof(gpio_v2_line_event));
+    for (int i = 0; i < count; ++i) {
+        const int index = chip->lines.indexOf(static_cast<int>(events[i].offset));
+        if (index < 0) {
+            continue;
+        }
+        ++m_edges;
+        emit buttonEvent(chip->keys.at(index), events[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE,
+                         static_cast<qint64>(events[i].timestamp_ns));
+    }
+}
+
+void ButtonInput::readMock()
+{
+    const qint64 timestamp = FrameStatistics::monotonicNsecs();
+    char buffer[256];
+    const ssize_t res = read(m_mockFile, buffer, sizeof(buffer));
+    if (res <= 0) {
+        if (res == 0) {
+            // end of a regular file, it will not grow
+            m_mockNotifier->setEnabled(false);
+        }
+        return;
+    }
+    m_mockBuffer.append(buffer, static_cast<int>(res));
+
+    int end;
+    while ((end = m_mockBuffer.indexOf('\n')) >= 0) {
+        const QString line = QString::fromLocal8Bit(m_mockBuffer.left(end)).trimmed();
+        m_mockBuffer.remove(0, end + 1);
+        const int space = line.lastIndexOf(' ');
+        const int key = parseKey(line.left(space));
+        if ((space <= 0) || (key == 0)) {
+            if (!line.isEmpty()) {
+                qWarning() << "invalid mock button event" << line;
+            }
+            continue;
+        }
+        ++m_edges;
+        emit buttonEvent(key, line.mid(space + 1).trimmed() != "0", timestamp);
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef BUTTONINPUT_H
+#define BUTTONINPUT_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QString>
+
+// Watches buttons on GPIO lines through the Linux GPIO character device (uAPI v2, Linux 5.10)
+// and reports their edges with the kernel's CLOCK_MONOTONIC timestamp, so the time a button was
+// pressed is known even when the event loop gets to it later. The line request fds are watched
+// by the event loop of the thread the input lives in.
+//
+// A mock source reads lines of "<key> 1" for a press and "<key> 0" for a release from a file or
+// FIFO instead, stamped when they are read, for tests without GPIO hardware.
+class ButtonInput : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ButtonInput(QObject *parent = 0);
+    ~ButtonInput();
+
+    // "gpiochip0:17=Up" or "/dev/gpiochip0:17=Up", the key is a QKeySequence name
+    static bool parseButton(const QString &spec, QString *chip, int *line, int *key);
+
+    bool addButton(const QString &spec);
+    // lines are low while the button is pressed
+    void setActiveLow(bool activeLow);
+    // filtered by the kernel where the GPIO controller supports it
+    void setDebounce(int ms);
+
+    // requests the lines of every chip for edge events
+    bool open();
+    bool openMock(const QString &fileName);
+    void close();
+
+    quint64 edges() const;
+
+signals:
+    void buttonEvent(int key, bool pressed, qint64 timestampNs);
+
+private:
+    struct Chip
+    {
+        QString path;
+        QList<int> lines;
+        QList<int> keys;
+        int fd;
+        QSocketNotifier *notifier;
+    };
+
+    bool requestLines(Chip *chip);
+    void readEvents(Chip *chip);
+    void readMock();
+
+    QList<Chip *> m_chips;
+    bool m_activeLow;
+    int m_debounceMs;
+    int m_mockFile;
+    QSocketNotifier *m_mockNotifier;
+    QByteArray m_mockBuffer;
+    quint64 m_edges;
+};
+
+#endif // BUTTONINPUT_H
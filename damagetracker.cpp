@@ -0,0 +1,91 @@
+#include "damagetracker.h"
+
+#include <private/qquickitem_p.h>
+
+DamageTracker::DamageTracker()
+    : m_generation(0)
+    , m_full(true)
+{
+
+}
+
+void DamageTracker::reset()
+{
+    m_items.clear();
+    m_full = true;
+}
+
+QRect DamageTracker::collect(QQuickItem *root, const QSize &size)
+{
+    ++m_generation;
+    m_damage = QRectF();
+    visit(root, 1.0, false);
+
+    // items that are gone or hidden leave their last area behind
+    for (auto it = m_items.begin(); it != m_items.end();) {
+        if (it->generation != m_generation) {
+            damage(it->rect, false);
+            it = m_items.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    const QRect scene(QPoint(0, 0), size);
+    if (m_full) {
+        m_full = false;
+        return scene;
+    }
+    if (m_damage.isEmpty()) {
+        return QRect();
+    }
+    // antialiased edges and glyphs reach a little beyond the item bounds
+    return m_damage.toAlignedRect().adjusted(-1, -1, 1, 1) & scene;
+}
+
+void DamageTracker::visit(QQuickItem *item, qreal parentOpacity, bool referenced)
+{
+    const qreal opacity = parentOpacity * item->opacity();
+    if (!item->isVisible() || (opacity <= 0.0)) {
+        return;
+    }
+
+    QQuickItemPrivate *d = QQuickItemPrivate::get(item);
+    referenced = referenced || (d->extra.isAllocated() && (d->extra->effectRefCount > 0));
+
+    const QRectF rect = item->mapRectToScene(item->boundingRect());
+    if (item->flags() & QQuickItem::ItemHasContents) {
+        auto it = m_items.find(item);
+        if (it == m_items.end()) {
+            damage(rect, referenced);
+            ItemState state = {rect, opacity, m_generation};
+            m_items.insert(item, state);
+        } else {
+            if ((it->rect != rect) || (it->opacity != opacity) || (d->dirtyAttributes != 0)) {
+                damage(it->rect, referenced);
+                damage(rect, referenced);
+            }
+            it->rect = rect;
+            it->opacity = opacity;
+            it->generation = m_generation;
+        }
+    }
+
+    // clipping and stacking change how the children are drawn without making them dirty
+    if (d->dirtyAttributes & (QQuickItemPrivate::Clip | QQuickItemPrivate::ChildrenStackingChanged)) {
+        damage(rect | item->mapRectToScene(item->childrenRect()), referenced);
+    }
+
+    const QList<QQuickItem *> children = item->childItems();
+    for (QQuickItem *child : children) {
+        visit(child, opacity, referenced);
+    }
+}
+
+void DamageTracker::damage(const QRectF &rect, bool referenced)
+{
+    if (referenced) {
+        m_full = true;
+    }
+    m_damage |= rect;
+}
@@ -0,0 +1,43 @@
+#ifndef DAMAGETRACKER_H
+#define DAMAGETRACKER_H
+
+#include <QHash>
+#include <QQuickItem>
+#include <QRect>
+#include <QRectF>
+#include <QSize>
+
+// Finds the part of a Qt Quick scene that changed since the last call from the items the scene
+// graph is about to synchronise. Call it after polishing and before syncing, while the items
+// still carry their dirty state. An item counts as changed when it is dirty or when its scene
+// rectangle, opacity or visibility differ from the last frame, and both its old and new area are
+// damaged. Changes under an item that is the source of an effect damage the whole scene, as the
+// effect may draw that content anywhere.
+class DamageTracker
+{
+public:
+    DamageTracker();
+
+    // the damaged area in scene coordinates, clipped to the scene size
+    QRect collect(QQuickItem *root, const QSize &size);
+    // makes the next collect() damage the whole scene
+    void reset();
+
+private:
+    struct ItemState
+    {
+        QRectF rect;
+        qreal opacity;
+        quint32 generation;
+    };
+
+    void visit(QQuickItem *item, qreal parentOpacity, bool referenced);
+    void damage(const QRectF &rect, bool referenced);
+
+    QHash<QQuickItem *, ItemState> m_items;
+    quint32 m_generation;
+    QRectF m_damage;
+    bool m_full;
+};
+
+#endif // DAMAGETRACKER_H
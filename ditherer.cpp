@@ -0,0 +1,178 @@
+#include "ditherer.h"
+
+#include <string.h>
+
+namespace {
+const int BAYER_INDEX[8][8] = {
+    { 0, 32,  8, 40,  2, 34, 10, 42},
+    {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44,  4, 36, 14, 46,  6, 38},
+    {60, 28, 52, 20, 62, 30, 54, 22},
+    { 3, 35, 11, 43,  1, 33,  9, 41},
+    {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47,  7, 39, 13, 45,  5, 37},
+    {63, 31, 55, 23, 61, 29, 53, 21}
+};
+
+inline void setBit(uchar *line, int x)
+{
+    line[x >> 3] |= static_cast<uchar>(0x80 >> (x & 7));
+}
+}
+
+Ditherer::Ditherer()
+    : m_mode(Threshold)
+{
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            m_bayer[y][x] = static_cast<uint8_t>((BAYER_INDEX[y][x] * 255 + 32) / 64);
+        }
+    }
+}
+
+bool Ditherer::parseMode(const QString &name, Mode *mode)
+{
+    const QString lower = name.toLower();
+    if (lower == "threshold") {
+        *mode = Threshold;
+    } else if (lower == "bayer") {
+        *mode = Bayer;
+    } else if (lower == "floyd-steinberg") {
+        *mode = FloydSteinberg;
+    } else if (lower == "atkinson") {
+        *mode = Atkinson;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *Ditherer::modeName(Mode mode)
+{
+    switch (mode) {
+    case Threshold:
+        return "threshold";
+    case Bayer:
+        return "bayer";
+    case FloydSteinberg:
+        return "floyd-steinberg";
+    case Atkinson:
+        return "atkinson";
+    }
+    return "unknown";
+}
+
+void Ditherer::setMode(Mode mode)
+{
+    m_mode = mode;
+}
+
+Ditherer::Mode Ditherer::mode() const
+{
+    return m_mode;
+}
+
+void Ditherer::lumaLine(const QRgb *line, int width, int16_t *out) const
+{
+    // same weights as qGray, written out so the loop vectorises
+    for (int x = 0; x < width; ++x) {
+        const QRgb pixel = line[x];
+        const int gray = (((pixel >> 16) & 0xff) * 11 + ((pixel >> 8) & 0xff) * 16 + (pixel & 0xff) * 5) >> 5;
+        out[x] = static_cast<int16_t>(255 - gray);
+    }
+}
+
+bool Ditherer::diffusesErrors() const
+{
+    return (m_mode == FloydSteinberg) || (m_mode == Atkinson);
+}
+
+void Ditherer::dither(const QImage &image, int width, int height, uchar *bits, int bytesPerLine, int firstLine)
+{
+    // the error lines carry two pixels of padding on both sides
+    const int padded = width + 4;
+    m_luma.resize(width);
+    for (QVector<int16_t> &errors : m_errors) {
+        if (errors.size() != padded) {
+            errors.fill(0, padded);
+        }
+    }
+    if (diffusesErrors()) {
+        for (QVector<int16_t> &errors : m_errors) {
+            errors.fill(0);
+        }
+    }
+
+    int16_t *luma = m_luma.data();
+    for (int y = firstLine; y < height; ++y) {
+        uchar *out = bits + y * bytesPerLine;
+        memset(out, 0, static_cast<size_t>(bytesPerLine));
+        lumaLine(reinterpret_cast<const QRgb *>(image.constScanLine(y)), width, luma);
+
+        switch (m_mode) {
+        case Threshold:
+            for (int x = 0; x < width; ++x) {
+                if (luma[x] >= 128) {
+                    setBit(out, x);
+                }
+            }
+            break;
+        case Bayer: {
+            const uint8_t *thresholds = m_bayer[y & 7];
+            for (int x = 0; x < width; ++x) {
+                if (luma[x] > thresholds[x & 7]) {
+                    setBit(out, x);
+                }
+            }
+            break;
+        }
+        case FloydSteinberg:
+        case Atkinson: {
+            // m_errors[0] holds the error pending for this line, [1] and [2] for the next two
+            int16_t *current = m_errors[0].data() + 2;
+            int16_t *next = m_errors[1].data() + 2;
+            int16_t *after = m_errors[2].data() + 2;
+
+            for (int x = 0; x < width; ++x) {
+                luma[x] = static_cast<int16_t>(luma[x] + current[x]);
+            }
+
+            for (int x = 0; x < width; ++x) {
+                const int value = luma[x];
+                const int lit = value >= 128 ? 255 : 0;
+                const int error = value - lit;
+                if (lit) {
+                    setBit(out, x);
+                }
+
+                if (m_mode == FloydSteinberg) {
+                    if (x + 1 < width) {
+                        luma[x + 1] += static_cast<int16_t>(error * 7 / 16);
+                    }
+                    next[x - 1] += static_cast<int16_t>(error * 3 / 16);
+                    next[x] += static_cast<int16_t>(error * 5 / 16);
+                    next[x + 1] += static_cast<int16_t>(error / 16);
+                } else {
+                    const int16_t share = static_cast<int16_t>(error / 8);
+                    if (x + 1 < width) {
+                        luma[x + 1] += share;
+                    }
+                    if (x + 2 < width) {
+                        luma[x + 2] += share;
+                    }
+                    next[x - 1] += share;
+                    next[x] += share;
+                    next[x + 1] += share;
+                    after[x] += share;
+                }
+            }
+
+            // rotate the error lines, the line that was just consumed becomes the last one
+            memset(m_errors[0].data(), 0, static_cast<size_t>(padded) * sizeof(int16_t));
+            m_errors[0].swap(m_errors[1]);
+            m_errors[1].swap(m_errors[2]);
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef DITHERER_H
+#define DITHERER_H
+
+#include <QImage>
+#include <QString>
+#include <QVector>
+#include <stdint.h>
+
+// Converts 32 bit images into 1 bpp scanlines (MSB first, 1 = lit) right before packing, so
+// no intermediate Format_Mono image is allocated per frame. Dark pixels light up.
+class Ditherer
+{
+public:
+    enum Mode {
+        Threshold,
+        Bayer,
+        FloydSteinberg,
+        Atkinson
+    };
+
+    Ditherer();
+
+    static bool parseMode(const QString &name, Mode *mode);
+    static const char *modeName(Mode mode);
+
+    void setMode(Mode mode);
+    Mode mode() const;
+
+    // converts lines firstLine to height - 1, image must be one of the 32 bit RGB formats and
+    // at least width x height pixels
+    void dither(const QImage &image, int width, int height, uchar *bits, int bytesPerLine, int firstLine = 0);
+    // whether a line depends on the lines above it, error diffusion has to start at line 0
+    bool diffusesErrors() const;
+
+private:
+    void lumaLine(const QRgb *line, int width, int16_t *out) const;
+
+    Mode m_mode;
+    uint8_t m_bayer[8][8];
+    QVector<int16_t> m_luma;
+    QVector<int16_t> m_errors[3];
+};
+
+#endif // DITHERER_H
@@ -0,0 +1,319 @@
+#include "framerecording.h"
+
+#include <QDebug>
+#include <string.h>
+
+namespace {
+const char MAGIC[8] = {'O', 'L', 'E', 'D', 'R', 'E', 'C', '\0'};
+const quint16 VERSION = 1;
+const qint64 CHUNK_BYTES = 1024 * 1024;
+
+struct FileHeader
+{
+    char magic[8];
+    quint16 version;
+    quint16 controller;
+    quint16 width;
+    quint16 height;
+    quint16 units;
+    quint16 unitBytes;
+    quint8 reserved[12];
+};
+
+struct RecordHeader
+{
+    quint32 size;
+    quint8 startLine;
+    quint8 mode;
+    quint16 spans;
+    qint64 timestamp;
+};
+
+struct RecordSpan
+{
+    quint8 firstPage;
+    quint8 lastPage;
+    quint8 firstColumn;
+    quint8 lastColumn;
+};
+
+static_assert(sizeof(FileHeader) == 32, "recording file header layout");
+static_assert(sizeof(RecordHeader) == 16, "recording record header layout");
+static_assert(sizeof(RecordSpan) == 4, "recording span layout");
+
+qint64 alignRecord(qint64 bytes)
+{
+    return (bytes + 7) & ~qint64(7);
+}
+}
+
+FrameRecorder::FrameRecorder()
+    : m_map(nullptr)
+    , m_mapped(0)
+    , m_used(0)
+    , m_ramBytes(0)
+    , m_lastStartLine(-1)
+    , m_frames(0)
+{
+
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    close();
+}
+
+bool FrameRecorder::open(const QString &fileName, OledController::Type controller, const QSize &size,
+                         int units, int unitBytes)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        qWarning() << "cannot open recording" << fileName << m_file.errorString();
+        return false;
+    }
+
+    m_ramBytes = units * unitBytes;
+    m_lastStartLine = -1;
+    m_frames = 0;
+    if (!reserve(sizeof(FileHeader))) {
+        close();
+        return false;
+    }
+
+    FileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.controller = static_cast<quint16>(controller);
+    header.width = static_cast<quint16>(size.width());
+    header.height = static_cast<quint16>(size.height());
+    header.units = static_cast<quint16>(units);
+    header.unitBytes = static_cast<quint16>(unitBytes);
+    memcpy(m_map, &header, sizeof(header));
+    m_used = sizeof(header);
+
+    m_clock.start();
+    return true;
+}
+
+void FrameRecorder::close()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+
+    if (m_map != nullptr) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    m_file.resize(m_used);
+    m_file.close();
+    m_mapped = 0;
+    m_used = 0;
+}
+
+bool FrameRecorder::isOpen() const
+{
+    return m_map != nullptr;
+}
+
+quint64 FrameRecorder::frames() const
+{
+    return m_frames;
+}
+
+bool FrameRecorder::reserve(qint64 bytes)
+{
+    if (m_used + bytes <= m_mapped) {
+        return true;
+    }
+
+    // grow by whole chunks so the file is remapped rarely
+    const qint64 size = m_mapped + qMax(CHUNK_BYTES, alignRecord(bytes));
+    if (m_map != nullptr) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    if (!m_file.resize(size)) {
+        qWarning() << "cannot grow recording" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+    m_map = m_file.map(0, size);
+    if (m_map == nullptr) {
+        qWarning() << "cannot map recording" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+    m_mapped = size;
+    return true;
+}
+
+void FrameRecorder::append(const uint8_t *ram, int startLine, const TransferPlan &plan)
+{
+    if ((m_map == nullptr) || (plan.isEmpty() && (startLine == m_lastStartLine))) {
+        return;
+    }
+
+    const int spans = plan.spans.size();
+    const qint64 size = alignRecord(sizeof(RecordHeader) + spans * sizeof(RecordSpan) + m_ramBytes);
+    if (!reserve(size)) {
+        close();
+        return;
+    }
+
+    uchar *record = m_map + m_used;
+    RecordHeader header;
+    header.size = 0;
+    header.startLine = static_cast<quint8>(startLine);
+    header.mode = static_cast<quint8>(plan.mode);
+    header.spans = static_cast<quint16>(spans);
+    header.timestamp = m_clock.nsecsElapsed();
+    memcpy(record, &header, sizeof(header));
+
+    uchar *pos = record + sizeof(header);
+    for (const TransferSpan &span : plan.spans) {
+        const RecordSpan recorded = {
+            static_cast<quint8>(span.firstPage), static_cast<quint8>(span.lastPage),
+            static_cast<quint8>(span.firstColumn), static_cast<quint8>(span.lastColumn)
+        };
+        memcpy(pos, &recorded, sizeof(recorded));
+        pos += sizeof(recorded);
+    }
+    memcpy(pos, ram, static_cast<size_t>(m_ramBytes));
+
+    // the size goes in last, until then the record reads as the end of the recording
+    const quint32 recordSize = static_cast<quint32>(size);
+    memcpy(record, &recordSize, sizeof(recordSize));
+
+    m_used += size;
+    m_lastStartLine = startLine;
+    ++m_frames;
+}
+
+FrameRecording::FrameRecording()
+    : m_map(nullptr)
+    , m_size(0)
+    , m_position(0)
+    , m_controller(OledController::SSD1306)
+    , m_units(0)
+    , m_unitBytes(0)
+{
+
+}
+
+FrameRecording::~FrameRecording()
+{
+    close();
+}
+
+bool FrameRecording::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        qWarning() << "cannot open recording" << fileName << m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    if (m_size >= static_cast<qint64>(sizeof(FileHeader))) {
+        m_map = m_file.map(0, m_size);
+    }
+    if (m_map == nullptr) {
+        qWarning() << "cannot map recording" << fileName;
+        close();
+        return false;
+    }
+
+    FileHeader header;
+    memcpy(&header, m_map, sizeof(header));
+    if ((memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) || (header.version != VERSION)
+            || (header.controller > OledController::SSD1322)) {
+        qWarning() << fileName << "is not a recording this version can read";
+        close();
+        return false;
+    }
+
+    m_controller = static_cast<OledController::Type>(header.controller);
+    m_panelSize = QSize(header.width, header.height);
+    m_units = header.units;
+    m_unitBytes = header.unitBytes;
+    m_position = sizeof(header);
+    return true;
+}
+
+void FrameRecording::close()
+{
+    if (m_map != nullptr) {
+        m_file.unmap(const_cast<uchar *>(m_map));
+        m_map = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_position = 0;
+}
+
+OledController::Type FrameRecording::controller() const
+{
+    return m_controller;
+}
+
+QSize FrameRecording::size() const
+{
+    return m_panelSize;
+}
+
+int FrameRecording::ramUnits() const
+{
+    return m_units;
+}
+
+int FrameRecording::unitBytes() const
+{
+    return m_unitBytes;
+}
+
+void FrameRecording::rewind()
+{
+    m_position = sizeof(FileHeader);
+}
+
+bool FrameRecording::next(Frame *frame)
+{
+    if ((m_map == nullptr) || (m_position + static_cast<qint64>(sizeof(RecordHeader)) > m_size)) {
+        return false;
+    }
+
+    RecordHeader header;
+    memcpy(&header, m_map + m_position, sizeof(header));
+    const qint64 ramBytes = m_units * m_unitBytes;
+    const qint64 minimum = sizeof(RecordHeader) + header.spans * sizeof(RecordSpan) + ramBytes;
+    if ((header.size < minimum) || (m_position + header.size > m_size) || (header.mode > TransferPlan::Page)) {
+        return false;
+    }
+
+    // spans are checked so a damaged file cannot make the driver read outside its buffers
+    const uchar *pos = m_map + m_position + sizeof(header);
+    frame->plan.spans.resize(0);
+    for (int i = 0; i < header.spans; ++i) {
+        RecordSpan recorded;
+        memcpy(&recorded, pos, sizeof(recorded));
+        pos += sizeof(recorded);
+        if ((recorded.firstPage > recorded.lastPage) || (recorded.lastPage >= m_units)
+                || (recorded.firstColumn > recorded.lastColumn) || (recorded.lastColumn >= m_unitBytes)) {
+            return false;
+        }
+        const TransferSpan span = {recorded.firstPage, recorded.lastPage, recorded.firstColumn, recorded.lastColumn};
+        frame->plan.spans.append(span);
+    }
+
+    frame->timestamp = header.timestamp;
+    frame->startLine = header.startLine;
+    frame->plan.mode = static_cast<TransferPlan::Mode>(header.mode);
+    frame->plan.cost = 0;
+    frame->ram = pos;
+    m_position += header.size;
+    return true;
+}
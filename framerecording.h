@@ -0,0 +1,101 @@
+#ifndef FRAMERECORDING_H
+#define FRAMERECORDING_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSize>
+#include <QString>
+#include <stdint.h>
+#include "oledcontroller.h"
+#include "transferplanner.h"
+
+// Recordings hold every GDDRAM image written to the panel together with the transfer plan that
+// sent it. All fields are in host byte order.
+//
+// File header, 32 bytes:
+//   0  char[8]   "OLEDREC" followed by a zero byte
+//   8  uint16    format version, 1
+//  10  uint16    controller, OledController::Type
+//  12  uint16    panel width in pixels
+//  14  uint16    panel height in pixels
+//  16  uint16    GDDRAM units (pages or lines)
+//  18  uint16    bytes per GDDRAM unit
+//  20  12 bytes  reserved, zero
+//
+// Records follow back to back, each starting at a multiple of 8 bytes:
+//   0  uint32    record size including this header and the padding, 0 ends the recording
+//   4  uint8     display start line
+//   5  uint8     addressing mode, TransferPlan::Mode
+//   6  uint16    number of spans n
+//   8  int64     nanoseconds since the recording started
+//  16  n x 4     spans as uint8 first page, last page, first column, last column
+//      units x bytes per unit GDDRAM image after the transfer
+//      padding to the next multiple of 8 bytes
+//
+// The file grows in chunks of zeros, a record's size is written last so a recording that was
+// not closed properly ends at the last complete record.
+class FrameRecorder
+{
+public:
+    FrameRecorder();
+    ~FrameRecorder();
+
+    bool open(const QString &fileName, OledController::Type controller, const QSize &size, int units, int unitBytes);
+    void close();
+    bool isOpen() const;
+
+    // records a GDDRAM image unless neither the content nor the start line changed
+    void append(const uint8_t *ram, int startLine, const TransferPlan &plan);
+    quint64 frames() const;
+
+private:
+    bool reserve(qint64 bytes);
+
+    QFile m_file;
+    uchar *m_map;
+    qint64 m_mapped;
+    qint64 m_used;
+    int m_ramBytes;
+    int m_lastStartLine;
+    quint64 m_frames;
+    QElapsedTimer m_clock;
+};
+
+class FrameRecording
+{
+public:
+    struct Frame
+    {
+        qint64 timestamp;
+        int startLine;
+        TransferPlan plan;
+        const uint8_t *ram; // points into the mapped file
+    };
+
+    FrameRecording();
+    ~FrameRecording();
+
+    bool open(const QString &fileName);
+    void close();
+
+    OledController::Type controller() const;
+    QSize size() const;
+    int ramUnits() const;
+    int unitBytes() const;
+
+    // reads the next record, false at the end of the recording or at a damaged record
+    bool next(Frame *frame);
+    void rewind();
+
+private:
+    QFile m_file;
+    const uchar *m_map;
+    qint64 m_size;
+    qint64 m_position;
+    OledController::Type m_controller;
+    QSize m_panelSize;
+    int m_units;
+    int m_unitBytes;
+};
+
+#endif // FRAMERECORDING_H
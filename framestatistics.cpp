@@ -0,0 +1,136 @@
+#include "framestatistics.h"
+
+#include <QStringList>
+#include <algorithm>
+#include <time.h>
+
+FrameStatistics::FrameStatistics(int capacity)
+    : m_capacity(capacity)
+{
+    for (int i = 0; i < StageCount; ++i) {
+        m_samples[i] = new QAtomicInteger<qint64>[m_capacity];
+    }
+    reset();
+}
+
+FrameStatistics::~FrameStatistics()
+{
+    for (int i = 0; i < StageCount; ++i) {
+        delete[] m_samples[i];
+    }
+}
+
+void FrameStatistics::addSample(Stage stage, qint64 nsecs)
+{
+    // a slot is claimed with a single atomic add, so even two writers of a stage do not collide
+    const quint64 slot = m_total[stage].fetchAndAddOrdered(1);
+    m_samples[stage][slot % static_cast<quint64>(m_capacity)].store(nsecs);
+    m_sum[stage].fetchAndAddRelaxed(nsecs);
+}
+
+void FrameStatistics::reset()
+{
+    for (int i = 0; i < StageCount; ++i) {
+        m_total[i].store(0);
+        m_sum[i].store(0);
+    }
+}
+
+int FrameStatistics::count(Stage stage) const
+{
+    return static_cast<int>(qMin(m_total[stage].load(), static_cast<quint64>(m_capacity)));
+}
+
+quint64 FrameStatistics::total(Stage stage) const
+{
+    return m_total[stage].load();
+}
+
+qint64 FrameStatistics::sum(Stage stage) const
+{
+    return m_sum[stage].load();
+}
+
+QVector<qint64> FrameStatistics::window(Stage stage) const
+{
+    const int samples = count(stage);
+    QVector<qint64> result(samples);
+    for (int i = 0; i < samples; ++i) {
+        result[i] = m_samples[stage][i].load();
+    }
+    return result;
+}
+
+qint64 FrameStatistics::quantile(Stage stage, qreal q) const
+{
+    QVector<qint64> sorted = window(stage);
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+
+    // the window is small, sorting a copy is cheaper than keeping a histogram up to date
+    std::sort(sorted.begin(), sorted.end());
+    int index = qBound(0, static_cast<int>(q * (sorted.size() - 1) + 0.5), sorted.size() - 1);
+    return sorted.at(index);
+}
+
+qint64 FrameStatistics::maximum(Stage stage) const
+{
+    const QVector<qint64> samples = window(stage);
+    qint64 result = 0;
+    for (qint64 sample : samples) {
+        result = qMax(result, sample);
+    }
+    return result;
+}
+
+QString FrameStatistics::summary() const
+{
+    QStringList lines;
+    for (int i = 0; i < StageCount; ++i) {
+        const Stage stage = static_cast<Stage>(i);
+        if (count(stage) == 0) {
+            continue;
+        }
+        lines.append(QString("%1: n=%2 p50=%3us p99=%4us max=%5us")
+                     .arg(stageName(stage))
+                     .arg(count(stage))
+                     .arg(quantile(stage, 0.5) / 1000)
+                     .arg(quantile(stage, 0.99) / 1000)
+                     .arg(maximum(stage) / 1000));
+    }
+    return lines.join('\n');
+}
+
+const char *FrameStatistics::stageName(Stage stage)
+{
+    switch (stage) {
+    case FrameTime:
+        return "frame";
+    case FrameInterval:
+        return "interval";
+    case Render:
+        return "render";
+    case Readback:
+        return "readback";
+    case GarbageCollection:
+        return "gc";
+    case SubFrame:
+        return "subframe";
+    case Pack:
+        return "pack";
+    case Transfer:
+        return "transfer";
+    case InputLatency:
+        return "input";
+    default:
+        return "unknown";
+    }
+}
+
+qint64 FrameStatistics::monotonicNsecs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<qint64>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
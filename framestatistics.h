@@ -0,0 +1,57 @@
+#ifndef FRAMESTATISTICS_H
+#define FRAMESTATISTICS_H
+
+#include <QAtomicInteger>
+#include <QString>
+#include <QVector>
+
+// Keeps the last samples of every stage. Samples are added without locking from any thread,
+// readers copy the window and may see a sample that is being replaced, which is fine for
+// statistics.
+class FrameStatistics
+{
+public:
+    enum Stage {
+        FrameTime,
+        FrameInterval,
+        Render,
+        Readback,
+        GarbageCollection,
+        SubFrame,
+        Pack,
+        Transfer,
+        InputLatency,
+        StageCount
+    };
+
+    explicit FrameStatistics(int capacity = 512);
+    ~FrameStatistics();
+
+    void addSample(Stage stage, qint64 nsecs);
+    void reset();
+
+    int count(Stage stage) const;
+    // every sample since the start and their sum, as monitoring systems expect for summaries
+    quint64 total(Stage stage) const;
+    qint64 sum(Stage stage) const;
+    qint64 quantile(Stage stage, qreal q) const;
+    qint64 maximum(Stage stage) const;
+
+    QString summary() const;
+
+    static const char *stageName(Stage stage);
+    // CLOCK_MONOTONIC, the clock of GPIO event timestamps
+    static qint64 monotonicNsecs();
+
+private:
+    Q_DISABLE_COPY(FrameStatistics)
+
+    QVector<qint64> window(Stage stage) const;
+
+    int m_capacity;
+    QAtomicInteger<qint64> *m_samples[StageCount];
+    QAtomicInteger<quint64> m_total[StageCount];
+    QAtomicInteger<qint64> m_sum[StageCount];
+};
+
+#endif // FRAMESTATISTICS_H
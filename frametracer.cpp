@@ -0,0 +1,207 @@
+#include "frametracer.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QThread>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "framestatistics.h"
+
+QAtomicPointer<FrameTracer> FrameTracer::s_active;
+int FrameTracer::s_signalPipe[2] = { -1, -1 };
+
+namespace {
+// the kernel thread id is what other tools show, it is looked up once per thread
+thread_local int threadId = 0;
+}
+
+FrameTracer::FrameTracer(QObject *parent)
+    : QObject(parent)
+    , m_events(nullptr)
+    , m_capacity(0)
+    , m_next(0)
+    , m_signalNotifier(nullptr)
+{
+
+}
+
+FrameTracer::~FrameTracer()
+{
+    s_active.testAndSetOrdered(this, nullptr);
+    delete m_signalNotifier;
+    // the threads that record have stopped by now
+    delete[] m_events;
+}
+
+void FrameTracer::start(int capacity, const QString &fileName)
+{
+    m_fileName = fileName;
+    m_capacity = qMax(capacity, 1);
+    m_events = new Event[m_capacity];
+    for (int i = 0; i < m_capacity; ++i) {
+        m_events[i].sequence.store(0);
+    }
+    m_next.store(0);
+    s_active.store(this);
+}
+
+bool FrameTracer::isActive()
+{
+    return s_active.load() != nullptr;
+}
+
+void FrameTracer::record(const char *name, qint64 startNsecs, qint64 endNsecs, qint64 value)
+{
+    FrameTracer *tracer = s_active.load();
+    if (tracer != nullptr) {
+        tracer->append(name, startNsecs, endNsecs, value);
+    }
+}
+
+void FrameTracer::append(const char *name, qint64 startNsecs, qint64 endNsecs, qint64 value)
+{
+    const quint64 index = m_next.fetchAndAddRelaxed(1);
+    Event &event = m_events[index % static_cast<quint64>(m_capacity)];
+    event.sequence.store(0);
+    // a release store only orders what comes before it, the cleared sequence has to be visible
+    // before any field of the new event
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    event.name = name;
+    event.start = startNsecs;
+    event.duration = endNsecs - startNsecs;
+    event.value = value;
+    event.thread = currentThread();
+    event.sequence.storeRelease(index + 1);
+}
+
+int FrameTracer::currentThread()
+{
+    if (threadId == 0) {
+        threadId = static_cast<int>(syscall(SYS_gettid));
+        QThread *thread = QThread::currentThread();
+        QString name = thread->objectName();
+        if (name.isEmpty()) {
+            name = (thread == QCoreApplication::instance()->thread()) ? QString("main") : QString::number(threadId);
+        }
+        QMutexLocker locker(&m_threadMutex);
+        m_threads.append(qMakePair(threadId, name));
+    }
+    return threadId;
+}
+
+bool FrameTracer::write()
+{
+    if (m_events == nullptr) {
+        return false;
+    }
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "cannot write the trace to" << m_fileName << file.errorString();
+        return false;
+    }
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QByteArray out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    {
+        QMutexLocker locker(&m_threadMutex);
+        for (const QPair<int, QString> &thread : m_threads) {
+            out += QString("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%1,\"tid\":%2,\"args\":{\"name\":\"%3\"}},\n")
+                    .arg(pid).arg(thread.first).arg(thread.second).toUtf8();
+        }
+    }
+
+    // Events are copied while other threads keep recording, one that is rewritten meanwhile
+    // changes its sequence and is skipped.
+    const quint64 next = m_next.load();
+    const quint64 first = (next > static_cast<quint64>(m_capacity)) ? next - m_capacity : 0;
+    int written = 0;
+    for (quint64 index = first; index < next; ++index) {
+        const Event &event = m_events[index % static_cast<quint64>(m_capacity)];
+        const quint64 sequence = event.sequence.loadAcquire();
+        const char *name = event.name;
+        const qint64 start = event.start;
+        const qint64 duration = event.duration;
+        const qint64 value = event.value;
+        const int thread = event.thread;
+        // the copies above must be complete before the sequence is checked again
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if ((sequence != index + 1) || (event.sequence.load() != sequence)) {
+            continue;
+        }
+        out += QString("{\"name\":\"%1\",\"ph\":\"X\",\"pid\":%2,\"tid\":%3,\"ts\":%4,\"dur\":%5")
+                .arg(name).arg(pid).arg(thread).arg(start / 1e3, 0, 'f', 3).arg(duration / 1e3, 0, 'f', 3).toUtf8();
+        if (value >= 0) {
+            out += QString(",\"args\":{\"value\":%1}").arg(value).toUtf8();
+        }
+        out += "},\n";
+        ++written;
+    }
+    // the metadata event keeps the list free of a trailing comma
+    out += QString("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%1,\"args\":{\"name\":\"qml-oled-renderer\"}}\n]}\n")
+            .arg(pid).toUtf8();
+
+    if (file.write(out) != out.size()) {
+        qWarning() << "cannot write the trace to" << m_fileName << file.errorString();
+        return false;
+    }
+    qDebug().noquote() << QString("trace: %1 events written to %2").arg(written).arg(m_fileName);
+    return true;
+}
+
+bool FrameTracer::handleSignals()
+{
+    // the handler only writes the signal number to a pipe, the event loop does the rest
+    if (pipe2(s_signalPipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        qWarning() << "cannot create the signal pipe" << strerror(errno);
+        return false;
+    }
+    m_signalNotifier = new QSocketNotifier(s_signalPipe[0], QSocketNotifier::Read);
+    connect(m_signalNotifier, &QSocketNotifier::activated, this, &FrameTracer::readSignals);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &FrameTracer::signalHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    const int handled[] = { SIGUSR1, SIGINT, SIGTERM };
+    for (int signum : handled) {
+        if (sigaction(signum, &action, nullptr) < 0) {
+            qWarning() << "cannot handle signal" << signum << strerror(errno);
+            return false;
+        }
+    }
+    return true;
+}
+
+void FrameTracer::signalHandler(int signum)
+{
+    const int error = errno;
+    const char byte = static_cast<char>(signum);
+    if (::write(s_signalPipe[1], &byte, 1) < 0) {
+        // the pipe is full, the signals already in it are handled
+    }
+    errno = error;
+}
+
+void FrameTracer::readSignals()
+{
+    char received[16];
+    const ssize_t count = read(s_signalPipe[0], received, sizeof(received));
+    for (ssize_t i = 0; i < count; ++i) {
+        if (received[i] == SIGUSR1) {
+            write();
+        } else {
+            QCoreApplication::quit();
+        }
+    }
+}
+
+qint64 TraceSpan::now()
+{
+    return FrameStatistics::monotonicNsecs();
+}
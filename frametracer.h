@@ -0,0 +1,97 @@
+#ifndef FRAMETRACER_H
+#define FRAMETRACER_H
+
+#include <QAtomicInteger>
+#include <QAtomicPointer>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QSocketNotifier>
+#include <QString>
+
+// Records the begin and duration of the stages of every frame into a ring buffer allocated up
+// front, to see why a particular frame was late where the statistics only show that some were.
+// Recording an event takes two clock reads and an atomic add, without locks or allocations, so
+// it can be enabled on a running unit while a stutter is reproduced. The buffer is written as
+// Chrome trace JSON, which chrome://tracing and the Perfetto UI open.
+class FrameTracer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FrameTracer(QObject *parent = 0);
+    ~FrameTracer();
+
+    // keeps the last <capacity> events and makes this the tracer TraceSpan records into
+    void start(int capacity, const QString &fileName);
+    // the recording so far, events still being recorded are left out
+    bool write();
+    // SIGUSR1 writes the trace, SIGINT and SIGTERM quit the application so it is written on exit
+    bool handleSignals();
+
+    static void record(const char *name, qint64 startNsecs, qint64 endNsecs, qint64 value);
+    static bool isActive();
+
+private:
+    struct Event
+    {
+        QAtomicInteger<quint64> sequence; // index of the event + 1, 0 while it is written
+        const char *name;
+        qint64 start;
+        qint64 duration;
+        qint64 value;
+        int thread;
+    };
+
+    void append(const char *name, qint64 startNsecs, qint64 endNsecs, qint64 value);
+    int currentThread();
+    void readSignals();
+    static void signalHandler(int signum);
+
+    static QAtomicPointer<FrameTracer> s_active;
+    static int s_signalPipe[2];
+
+    QString m_fileName;
+    Event *m_events;
+    int m_capacity;
+    QAtomicInteger<quint64> m_next;
+    QMutex m_threadMutex;
+    QList<QPair<int, QString> > m_threads;
+    QSocketNotifier *m_signalNotifier;
+};
+
+// Records the time from its construction to its destruction as an event when tracing
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name, qint64 value = -1)
+        : m_name(FrameTracer::isActive() ? name : nullptr)
+        , m_start(m_name != nullptr ? now() : 0)
+        , m_value(value)
+    {
+    }
+
+    ~TraceSpan()
+    {
+        if (m_name != nullptr) {
+            FrameTracer::record(m_name, m_start, now(), m_value);
+        }
+    }
+
+    // shown with the event, e.g. the bytes of a transfer
+    void setValue(qint64 value)
+    {
+        m_value = value;
+    }
+
+private:
+    Q_DISABLE_COPY(TraceSpan)
+
+    static qint64 now();
+
+    const char *m_name;
+    qint64 m_start;
+    qint64 m_value;
+};
+
+#endif // FRAMETRACER_H
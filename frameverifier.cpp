@@ -0,0 +1,210 @@
+#include "frameverifier.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QPainter>
+#include <QQuickItem>
+#include <QStringList>
+#include <algorithm>
+#include "monoitems.h"
+#include "ssd1306driver.h"
+#include "ssd1306emulator.h"
+
+namespace {
+// layout of the emulated GDDRAM
+const int RAM_COLUMNS = 128;
+const int RAM_LINES = 64;
+}
+
+FrameVerifier::FrameVerifier(const QSize &size, Ditherer::Mode ditherMode, QObject *parent)
+    : QObject(parent)
+    , m_size(size)
+    , m_mono(size.width() / 8 * size.height())
+    , m_expected(size.width() * size.height())
+    , m_root(nullptr)
+    , m_frames(0)
+    , m_monoFrames(0)
+    , m_frameCount(0)
+{
+    m_ditherer.setMode(ditherMode);
+}
+
+FrameVerifier::~FrameVerifier()
+{
+    for (Path &path : m_paths) {
+        path.driver->close();
+        delete path.emulator;
+        delete path.driver;
+    }
+}
+
+bool FrameVerifier::addPath(const QString &name, OledController::Type controller, bool hardwareScroll, bool fullFrames)
+{
+    Path path;
+    path.name = name;
+    path.driver = new Ssd1306Driver;
+    path.emulator = new Ssd1306Emulator;
+    path.fullFrames = fullFrames;
+    path.failures = 0;
+    path.driver->setController(controller);
+    path.driver->setDitherMode(m_ditherer.mode());
+    if (!path.driver->openFile(m_size, path.emulator->open())) {
+        qCritical() << "cannot open the emulated display for" << name;
+        delete path.emulator;
+        delete path.driver;
+        return false;
+    }
+    path.driver->setHardwareScrollEnabled(hardwareScroll);
+    m_paths.append(path);
+    return true;
+}
+
+void FrameVerifier::setFrameCount(int frames)
+{
+    m_frameCount = frames;
+}
+
+void FrameVerifier::setRootItem(QQuickItem *root)
+{
+    m_root = root;
+}
+
+int FrameVerifier::failures() const
+{
+    int failures = 0;
+    for (const Path &path : m_paths) {
+        failures += path.failures;
+    }
+    return failures;
+}
+
+QString FrameVerifier::summary() const
+{
+    QStringList paths;
+    for (const Path &path : m_paths) {
+        paths.append(QString("%1 %2/%3").arg(path.name).arg(m_frames - path.failures).arg(m_frames));
+    }
+    return QString("verified frames: %1 (%2 from the CPU path)").arg(paths.join(", ")).arg(m_monoFrames);
+}
+
+void FrameVerifier::verifyFrame(const QImage &image, const QRect &damage)
+{
+    if ((m_frameCount > 0) && (m_frames >= m_frameCount)) {
+        return;
+    }
+
+    if ((image.format() == QImage::Format_Mono) && (m_root != nullptr)) {
+        // a converted Format_Mono frame would only be compared with itself
+        ++m_monoFrames;
+        reference(toImage());
+    } else {
+        reference(image);
+    }
+    for (Path &path : m_paths) {
+        path.driver->writeImage(image, path.fullFrames ? image.rect() : damage);
+        if (!compare(&path)) {
+            ++path.failures;
+        }
+    }
+    ++m_frames;
+
+    if ((m_frameCount > 0) && (m_frames == m_frameCount)) {
+        qDebug().noquote() << summary();
+        QCoreApplication::exit((failures() > 0) ? 1 : 0);
+    }
+}
+
+void FrameVerifier::reference(const QImage &image)
+{
+    const int width = m_size.width();
+    const int height = m_size.height();
+    if (m_ditherer.mode() == Ditherer::Threshold) {
+        // the conversion the driver started out with
+        const QImage mono = image.convertToFormat(QImage::Format_Mono, Qt::ThresholdDither);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                m_expected[y * width + x] = (mono.pixelIndex(x, y) == 1) ? 1 : 0;
+            }
+        }
+        return;
+    }
+
+    // the other modes have no Qt counterpart, the whole frame is dithered at once instead
+    const int bytesPerLine = width / 8;
+    const QImage source = image.convertToFormat(QImage::Format_RGB32);
+    m_ditherer.dither(source, width, height, m_mono.data(), bytesPerLine);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            m_expected[y * width + x] = (m_mono.at(y * bytesPerLine + x / 8) >> (7 - x % 8)) & 1;
+        }
+    }
+}
+
+QImage FrameVerifier::toImage() const
+{
+    QImage image(m_size, QImage::Format_RGB32);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    paintItem(&painter, m_root, image.rect());
+    return image;
+}
+
+void FrameVerifier::paintItem(QPainter *painter, QQuickItem *item, const QRect &clip)
+{
+    if (!item->isVisible() || (item->opacity() <= 0.0)) {
+        return;
+    }
+
+    // the scene graph draws children with a negative z below their parent, the rest above it
+    const QRect bounds = item->mapRectToScene(QRectF(0, 0, item->width(), item->height())).toAlignedRect();
+    const QRect childClip = item->clip() ? (clip & bounds) : clip;
+    QList<QQuickItem *> children = item->childItems();
+    std::stable_sort(children.begin(), children.end(),
+                     [](const QQuickItem *a, const QQuickItem *b) { return a->z() < b->z(); });
+    int child = 0;
+    for (; (child < children.size()) && (children.at(child)->z() < 0.0); ++child) {
+        paintItem(painter, children.at(child), childClip);
+    }
+    if (MonoItem *monoItem = qobject_cast<MonoItem *>(item)) {
+        painter->save();
+        painter->setClipRect(clip & bounds);
+        painter->translate(item->mapToScene(QPointF(0, 0)));
+        monoItem->paint(painter);
+        painter->restore();
+    }
+    for (; child < children.size(); ++child) {
+        paintItem(painter, children.at(child), childClip);
+    }
+}
+
+bool FrameVerifier::compare(Path *path)
+{
+    if (!path->emulator->sync()) {
+        qCritical() << "the emulated display of" << path->name << "does not respond";
+        return false;
+    }
+
+    // panel line y shows GDDRAM line (start line + y) % 64
+    const QVector<uint8_t> gddram = path->emulator->gddram();
+    const int startLine = path->emulator->startLine();
+    const int width = m_size.width();
+    int mismatches = 0;
+    for (int y = 0; y < m_size.height(); ++y) {
+        const int line = (startLine + y) % RAM_LINES;
+        for (int x = 0; x < width; ++x) {
+            const int lit = (gddram.at(line / 8 * RAM_COLUMNS + x) >> (line % 8)) & 1;
+            if (lit == m_expected.at(y * width + x)) {
+                continue;
+            }
+            if (mismatches == 0) {
+                qWarning().noquote() << QString("%1: frame %2 differs at %3,%4 with start line %5")
+                                        .arg(path->name).arg(m_frames).arg(x).arg(y).arg(startLine);
+            }
+            ++mismatches;
+        }
+    }
+    if (mismatches > 0) {
+        qWarning().noquote() << QString("%1: frame %2 has %3 wrong pixels").arg(path->name).arg(m_frames).arg(mismatches);
+    }
+    return mismatches == 0;
+}
@@ -0,0 +1,75 @@
+#ifndef FRAMEVERIFIER_H
+#define FRAMEVERIFIER_H
+
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <stdint.h>
+#include "ditherer.h"
+#include "oledcontroller.h"
+
+class QPainter;
+class QQuickItem;
+class Ssd1306Driver;
+class Ssd1306Emulator;
+
+// Checks the fast display paths against the straightforward one, frame by frame. Every rendered
+// frame is converted the slow way, with QImage::convertToFormat() and pixelIndex() for the
+// threshold mode or a full frame dither otherwise, and is also written through drivers that
+// use damage, dirty diffing, transfer planning and hardware scrolling into emulated panels. The
+// panel contents, read from the emulated GDDRAM at its display start line, have to match the
+// reference bit for bit.
+//
+// Frames of a scene made of Mono items only come from the CPU path already in Format_Mono. Their
+// reference is painted by toImage() with QPainter, the way the scene graph draws the items.
+class FrameVerifier : public QObject
+{
+    Q_OBJECT
+public:
+    FrameVerifier(const QSize &size, Ditherer::Mode ditherMode, QObject *parent = 0);
+    ~FrameVerifier();
+
+    // the driver ignores the damage of the frames and converts them completely when fullFrames is set
+    bool addPath(const QString &name, OledController::Type controller, bool hardwareScroll, bool fullFrames);
+    // quits the application with 0 or 1 once <frames> frames were checked
+    void setFrameCount(int frames);
+    // the scene whose Mono items are painted as the reference of frames from the CPU path
+    void setRootItem(QQuickItem *root);
+
+    int failures() const;
+    QString summary() const;
+
+public slots:
+    void verifyFrame(const QImage &image, const QRect &damage);
+
+private:
+    struct Path
+    {
+        QString name;
+        Ssd1306Driver *driver;
+        Ssd1306Emulator *emulator;
+        bool fullFrames;
+        int failures;
+    };
+
+    void reference(const QImage &image);
+    QImage toImage() const;
+    static void paintItem(QPainter *painter, QQuickItem *item, const QRect &clip);
+    bool compare(Path *path);
+
+    QSize m_size;
+    Ditherer m_ditherer;
+    QVector<uchar> m_mono;
+    QVector<uint8_t> m_expected; // one byte per pixel, 1 where the panel is lit
+    QList<Path> m_paths;
+    QQuickItem *m_root;
+    int m_frames;
+    int m_monoFrames; // frames that came from the CPU path
+    int m_frameCount;
+};
+
+#endif // FRAMEVERIFIER_H
@@ -0,0 +1,457 @@
+#include "kernelbenchmark.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFont>
+#include <QPainter>
+#include <QTextStream>
+#include <fcntl.h>
+#include <random>
+#include <string.h>
+#include <unistd.h>
+#include "ditherer.h"
+#include "framerecording.h"
+#include "panelkernels.h"
+#include "transferplanner.h"
+
+extern "C" {
+    int ssd1306_cls(int file, int col, int line);
+}
+
+namespace {
+// synthetic frames per set, the kernels cycle through them so every call sees other pixels
+const int SET_FRAMES = 16;
+// the fastest of RUNS runs of at least RUN_NSECS each
+const int RUNS = 7;
+const qint64 RUN_NSECS = 20000000;
+
+QString sizeName(const QSize &size)
+{
+    return QString("%1x%2").arg(size.width()).arg(size.height());
+}
+}
+
+KernelBenchmark::KernelBenchmark()
+    : m_update(false)
+    , m_threshold(10)
+{
+
+}
+
+void KernelBenchmark::setBaselineFile(const QString &fileName)
+{
+    m_baselineFile = fileName;
+}
+
+void KernelBenchmark::setUpdateBaseline(bool update)
+{
+    m_update = update;
+}
+
+void KernelBenchmark::setThreshold(int percent)
+{
+    m_threshold = percent;
+}
+
+bool KernelBenchmark::addRecording(const QString &fileName)
+{
+    FrameRecording recording;
+    if (!recording.open(fileName)) {
+        return false;
+    }
+
+    FrameSet set;
+    set.name = QFileInfo(fileName).completeBaseName();
+    set.size = recording.size();
+    const int ramBytes = recording.ramUnits() * recording.unitBytes();
+    const bool mono = (recording.controller() != OledController::SSD1322);
+    const int unitBytes = mono ? set.size.width() : set.size.width() / 2;
+    if ((recording.unitBytes() != unitBytes)
+            || (recording.ramUnits() != (mono ? int(Ssd1306Traits::RamPages) : int(Ssd1322Traits::RamPages)))) {
+        qCritical() << "the GDDRAM layout of" << fileName << "does not match the kernels";
+        return false;
+    }
+    FrameRecording::Frame frame;
+    while (recording.next(&frame)) {
+        set.rams.append(QVector<uint8_t>(ramBytes));
+        memcpy(set.rams.last().data(), frame.ram, static_cast<size_t>(ramBytes));
+        if (mono) {
+            set.images.append(imageFromRam(frame.ram, set.size));
+        }
+    }
+    if (set.rams.size() < 2) {
+        qCritical() << "the recording" << fileName << "needs at least two frames";
+        return false;
+    }
+    if (!mono) {
+        // 4 bpp frames are only scanned and planned, there is no image to convert
+        set.images.clear();
+    }
+    m_recordings.append(set);
+    return true;
+}
+
+QImage KernelBenchmark::imageFromRam(const uint8_t *ram, const QSize &size)
+{
+    // lit pixels come from dark ones, the way the ditherer converts them
+    QImage image(size, QImage::Format_RGB32);
+    for (int y = 0; y < size.height(); ++y) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            const bool lit = (ram[(y / 8) * size.width() + x] >> (y % 8)) & 1;
+            line[x] = lit ? qRgb(0, 0, 0) : qRgb(255, 255, 255);
+        }
+    }
+    return image;
+}
+
+KernelBenchmark::FrameSet KernelBenchmark::noise(const QSize &size)
+{
+    // fixed seed, every run measures the same pixels
+    std::mt19937 random(1);
+    FrameSet set;
+    set.name = "noise";
+    set.size = size;
+    for (int i = 0; i < SET_FRAMES; ++i) {
+        QImage image(size, QImage::Format_RGB32);
+        for (int y = 0; y < size.height(); ++y) {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < size.width(); ++x) {
+                const int gray = static_cast<int>(random() & 0xff);
+                line[x] = qRgb(gray, gray, gray);
+            }
+        }
+        set.images.append(image);
+    }
+    return set;
+}
+
+KernelBenchmark::FrameSet KernelBenchmark::gradient(const QSize &size)
+{
+    // a gradient moving sideways, the whole panel changes a little every frame
+    FrameSet set;
+    set.name = "gradient";
+    set.size = size;
+    for (int i = 0; i < SET_FRAMES; ++i) {
+        QImage image(size, QImage::Format_RGB32);
+        for (int y = 0; y < size.height(); ++y) {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < size.width(); ++x) {
+                const int gray = ((x + i * 4) * 255 / size.width() + y) & 0xff;
+                line[x] = qRgb(gray, gray, gray);
+            }
+        }
+        set.images.append(image);
+    }
+    return set;
+}
+
+KernelBenchmark::FrameSet KernelBenchmark::text(const QSize &size)
+{
+    // a clock on a mostly static screen, the typical dashboard frame
+    FrameSet set;
+    set.name = "text";
+    set.size = size;
+    QFont font;
+    font.setPixelSize(qMax(8, size.height() / 3));
+    font.setStyleStrategy(QFont::NoAntialias);
+    for (int i = 0; i < SET_FRAMES; ++i) {
+        QImage image(size, QImage::Format_RGB32);
+        image.fill(Qt::white);
+        QPainter painter(&image);
+        painter.setFont(font);
+        painter.setPen(Qt::black);
+        painter.drawRect(0, 0, size.width() - 1, size.height() - 1);
+        painter.drawText(image.rect(), Qt::AlignCenter, QString("12:%1:%2").arg(i / 4, 2, 10, QChar('0'))
+                         .arg(i * 7 % 60, 2, 10, QChar('0')));
+        painter.end();
+        set.images.append(image);
+    }
+    return set;
+}
+
+void KernelBenchmark::measure(const QString &kernel, const QSize &size, const QString &frames,
+                              const std::function<void(int)> &function)
+{
+    // the calls per run are doubled until a run is long enough for the clock
+    int iterations = 1;
+    QElapsedTimer timer;
+    for (;;) {
+        timer.start();
+        for (int i = 0; i < iterations; ++i) {
+            function(i);
+        }
+        if ((timer.nsecsElapsed() >= RUN_NSECS) || (iterations >= (1 << 24))) {
+            break;
+        }
+        iterations *= 2;
+    }
+
+    qint64 best = -1;
+    for (int run = 0; run < RUNS; ++run) {
+        timer.start();
+        for (int i = 0; i < iterations; ++i) {
+            function(i);
+        }
+        const qint64 nsecs = timer.nsecsElapsed() / iterations;
+        best = (best < 0) ? nsecs : qMin(best, nsecs);
+    }
+    m_results.append(qMakePair(QString("%1 %2 %3").arg(kernel, sizeName(size), frames), best));
+}
+
+void KernelBenchmark::benchmarkMono(const FrameSet &set)
+{
+    const QSize size = set.size;
+    const int width = size.width();
+    const int height = size.height();
+    const int bytesPerLine = width / 8;
+    const int ramBytes = Ssd1306Traits::RamPages * width;
+    const PanelKernels kernels = PanelKernels::select(size);
+    const int count = set.images.size();
+
+    // the input of every kernel is prepared by the kernels before it
+    Ditherer threshold;
+    QVector<QVector<uchar> > monos;
+    QVector<QVector<uint8_t> > frames;
+    QVector<QVector<uint8_t> > rams = set.rams.toVector();
+    for (int i = 0; i < count; ++i) {
+        monos.append(QVector<uchar>(bytesPerLine * height));
+        threshold.dither(set.images.at(i), width, height, monos.last().data(), bytesPerLine);
+        frames.append(QVector<uint8_t>(ramBytes));
+        kernels.pack(monos.last().constData(), bytesPerLine, width, height, 0, height, frames.last().data());
+        if (set.rams.isEmpty()) {
+            const QVector<uint8_t> blank(ramBytes, 0);
+            rams.append(QVector<uint8_t>(ramBytes));
+            kernels.compose(frames.last().constData(), blank.constData(), 0, width, height, rams.last().data());
+        }
+    }
+    QVector<DirtyMap> dirty(rams.size());
+    for (int i = 0; i < rams.size(); ++i) {
+        kernels.scan(rams.at(i).constData(), rams.at((i + 1) % rams.size()).constData(), width, dirty[i]);
+    }
+
+    QVector<uchar> mono(bytesPerLine * height);
+    QVector<uint8_t> frame(ramBytes);
+    QVector<uint8_t> target(ramBytes);
+    DirtyMap scanned;
+    const Ditherer::Mode modes[] = { Ditherer::Threshold, Ditherer::Bayer, Ditherer::FloydSteinberg, Ditherer::Atkinson };
+    for (Ditherer::Mode mode : modes) {
+        Ditherer ditherer;
+        ditherer.setMode(mode);
+        measure(QString("dither-%1").arg(Ditherer::modeName(mode)), size, set.name, [&](int i) {
+            ditherer.dither(set.images.at(i % count), width, height, mono.data(), bytesPerLine);
+        });
+    }
+    measure("pack", size, set.name, [&](int i) {
+        kernels.pack(monos.at(i % count).constData(), bytesPerLine, width, height, 0, height, frame.data());
+    });
+    // the conversion the kernels replaced, Qt's threshold dither and one pixel at a time into pages
+    measure("reference", size, set.name, [&](int i) {
+        const QImage converted = set.images.at(i % count).convertToFormat(QImage::Format_Mono, Qt::ThresholdDither);
+        memset(frame.data(), 0, static_cast<size_t>(ramBytes));
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                if (converted.pixelIndex(x, y) == 1) {
+                    frame[(y / 8) * width + x] |= static_cast<uint8_t>(1 << (y % 8));
+                }
+            }
+        }
+    });
+    measure("compose", size, set.name, [&](int i) {
+        kernels.compose(frames.at(i % count).constData(), rams.at((i + 1) % rams.size()).constData(), i % 64,
+                        width, height, target.data());
+    });
+    measure("scan", size, set.name, [&](int i) {
+        kernels.scan(rams.at(i % rams.size()).constData(), rams.at((i + 1) % rams.size()).constData(), width, scanned);
+    });
+    measure("plan", size, set.name, [&](int i) {
+        TransferPlanner::plan(dirty.at(i % dirty.size()), TransferPlan::Horizontal);
+    });
+}
+
+void KernelBenchmark::benchmarkGray4(const FrameSet &set)
+{
+    const QSize size = set.size;
+    const int width = size.width();
+    const int height = size.height();
+    const int unitBytes = width / 2;
+    const PanelKernels kernels = PanelKernels::selectGray4(size);
+
+    QVector<QVector<uint8_t> > rams = set.rams.toVector();
+    for (const QImage &image : set.images) {
+        rams.append(QVector<uint8_t>(unitBytes * Ssd1322Traits::RamPages));
+        kernels.pack(image.constBits(), image.bytesPerLine(), width, height, 0, height, rams.last().data());
+    }
+
+    QVector<uint8_t> frame(unitBytes * Ssd1322Traits::RamPages);
+    DirtyMap scanned;
+    if (!set.images.isEmpty()) {
+        measure("pack-gray4", size, set.name, [&](int i) {
+            const QImage &image = set.images.at(i % set.images.size());
+            kernels.pack(image.constBits(), image.bytesPerLine(), width, height, 0, height, frame.data());
+        });
+    }
+    measure("scan", size, set.name, [&](int i) {
+        kernels.scan(rams.at(i % rams.size()).constData(), rams.at((i + 1) % rams.size()).constData(), unitBytes,
+                     scanned);
+    });
+    measure("plan", size, set.name, [&](int i) {
+        kernels.scan(rams.at(i % rams.size()).constData(), rams.at((i + 1) % rams.size()).constData(), unitBytes,
+                     scanned);
+        TransferPlanner::plan(scanned, TransferPlan::Horizontal, false);
+    });
+}
+
+void KernelBenchmark::benchmarkClear(const QSize &size)
+{
+    // the buffer setup of ssd1306_cls, written to /dev/null instead of the bus
+    const int file = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (file < 0) {
+        return;
+    }
+    measure("cls", size, "blank", [&](int) {
+        ssd1306_cls(file, size.width(), size.height());
+    });
+    ::close(file);
+}
+
+int KernelBenchmark::run()
+{
+    // the specialised kernels and a size that uses the generic ones
+    const QSize monoSizes[] = { QSize(128, 64), QSize(128, 32), QSize(96, 16), QSize(64, 48), QSize(72, 40) };
+    for (const QSize &size : monoSizes) {
+        benchmarkMono(noise(size));
+        benchmarkMono(gradient(size));
+        benchmarkMono(text(size));
+        benchmarkClear(size);
+    }
+    benchmarkGray4(gradient(QSize(256, 64)));
+    benchmarkGray4(text(QSize(256, 64)));
+    for (const FrameSet &set : m_recordings) {
+        if (set.images.isEmpty()) {
+            benchmarkGray4(set);
+        } else {
+            benchmarkMono(set);
+        }
+    }
+
+    const int slower = compareWithReference();
+    if (m_update) {
+        return writeBaseline() ? 0 : -1;
+    }
+    if (m_baselineFile.isEmpty()) {
+        // a baseline only compares on the board it was taken on, without one the reference is the check
+        qDebug() << "no board baseline given, only the reference conversion is compared";
+        return (slower > 0) ? 1 : 0;
+    }
+
+    QMap<QString, qint64> baseline;
+    if (!readBaseline(&baseline)) {
+        return -1;
+    }
+    int regressions = 0;
+    int missing = 0;
+    for (const QPair<QString, qint64> &result : m_results) {
+        if (!baseline.contains(result.first)) {
+            // a kernel without a baseline would never be checked
+            qDebug().noquote() << QString("%1: %2 ns, MISSING from the baseline").arg(result.first).arg(result.second);
+            ++missing;
+            continue;
+        }
+        const qint64 reference = baseline.value(result.first);
+        const qreal change = (reference > 0) ? (result.second - reference) * 100.0 / reference : 0;
+        const bool regressed = change > m_threshold;
+        qDebug().noquote() << QString("%1: %2 ns, baseline %3 ns, %4%5%")
+                              .arg(result.first).arg(result.second).arg(reference)
+                              .arg((change >= 0) ? "+" : "").arg(change, 0, 'f', 1)
+                              + (regressed ? " REGRESSION" : "");
+        if (regressed) {
+            ++regressions;
+        }
+    }
+    if (missing > 0) {
+        qCritical().noquote() << QString("%1 kernels are missing from %2, take the baseline with --benchmark-update")
+                                 .arg(missing).arg(m_baselineFile);
+    }
+    if (regressions > 0) {
+        qCritical().noquote() << QString("%1 kernels are more than %2% slower than the baseline")
+                                 .arg(regressions).arg(m_threshold);
+    }
+    return ((slower > 0) || (missing > 0) || (regressions > 0)) ? 1 : 0;
+}
+
+int KernelBenchmark::compareWithReference() const
+{
+    // Threshold dithering and packing do what the reference conversion does, they have to be
+    // faster than it on every set. Unlike the baseline this holds on any machine.
+    QMap<QString, qint64> results;
+    for (const QPair<QString, qint64> &result : m_results) {
+        results.insert(result.first, result.second);
+    }
+    int slower = 0;
+    for (const QPair<QString, qint64> &result : m_results) {
+        if (!result.first.startsWith("reference ")) {
+            continue;
+        }
+        const QString set = result.first.mid(result.first.indexOf(' ') + 1);
+        const qint64 fast = results.value("dither-threshold " + set) + results.value("pack " + set);
+        const qreal speedup = (fast > 0) ? qreal(result.second) / fast : 0;
+        qDebug().noquote() << QString("%1: dither-threshold and pack %2 ns, reference %3 ns, %4x faster")
+                              .arg(set).arg(fast).arg(result.second).arg(speedup, 0, 'f', 1)
+                              + ((fast >= result.second) ? " SLOWER" : "");
+        if (fast >= result.second) {
+            ++slower;
+        }
+    }
+    if (slower > 0) {
+        qCritical().noquote() << QString("%1 sets are converted faster by the reference than by the kernels").arg(slower);
+    }
+    return slower;
+}
+
+bool KernelBenchmark::readBaseline(QMap<QString, qint64> *baseline) const
+{
+    QFile file(m_baselineFile);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qCritical() << "cannot read the benchmark baseline" << m_baselineFile << file.errorString();
+        return false;
+    }
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        const QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        const int space = line.lastIndexOf(' ');
+        bool ok = false;
+        const qint64 nsecs = line.mid(space + 1).toLongLong(&ok);
+        if ((space <= 0) || !ok) {
+            qCritical() << "invalid benchmark baseline line" << line;
+            return false;
+        }
+        baseline->insert(line.left(space).simplified(), nsecs);
+    }
+    return true;
+}
+
+bool KernelBenchmark::writeBaseline() const
+{
+    if (m_baselineFile.isEmpty()) {
+        qCritical() << "the benchmark baseline to write is selected with --benchmark-baseline";
+        return false;
+    }
+    QFile file(m_baselineFile);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        qCritical() << "cannot write the benchmark baseline" << m_baselineFile << file.errorString();
+        return false;
+    }
+    QTextStream out(&file);
+    out << "# qml-oled-renderer --benchmark results: <kernel> <size> <frames> <nsecs per frame>\n";
+    for (const QPair<QString, qint64> &result : m_results) {
+        out << result.first << ' ' << result.second << '\n';
+    }
+    qDebug().noquote() << QString("%1 results written to %2").arg(m_results.size()).arg(m_baselineFile);
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef KERNELBENCHMARK_H
+#define KERNELBENCHMARK_H
+
+#include <QImage>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QSize>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include <stdint.h>
+
+// Measures the pixel kernels of the display path, the dithering modes, packing, composing onto
+// the GDDRAM, the dirty scan, transfer planning and the clear screen buffer setup, for a few
+// panel sizes on synthetic frames and on the frames of a recording. Every result is the fastest
+// of several runs in nanoseconds per frame, which is far less noisy than the mean.
+//
+// Threshold dithering and packing together have to beat the reference conversion through
+// QImage::convertToFormat() measured in the same run, which holds on any machine. With a
+// baseline file of "<kernel> <size> <frames> <nsecs>" lines taken on the same board a kernel
+// that became slower than the threshold allows or that has no baseline also fails the run.
+// Baselines are written with setUpdateBaseline().
+class KernelBenchmark
+{
+public:
+    KernelBenchmark();
+
+    // one file per board, without one only the reference conversion is compared
+    void setBaselineFile(const QString &fileName);
+    // writes the results as the new baseline instead of comparing with it
+    void setUpdateBaseline(bool update);
+    // allowed slowdown in percent before a kernel counts as a regression
+    void setThreshold(int percent);
+    // adds the frames of a recording made with --record
+    bool addRecording(const QString &fileName);
+
+    // returns 0, 1 when a kernel regressed or -1 when the baseline cannot be read or written
+    int run();
+
+private:
+    struct FrameSet
+    {
+        QString name;
+        QSize size;
+        QList<QImage> images;         // RGB32
+        QList<QVector<uint8_t> > rams; // GDDRAM images of the recording, empty for synthetic sets
+    };
+
+    static FrameSet noise(const QSize &size);
+    static FrameSet gradient(const QSize &size);
+    static FrameSet text(const QSize &size);
+    static QImage imageFromRam(const uint8_t *ram, const QSize &size);
+
+    void benchmarkMono(const FrameSet &set);
+    void benchmarkGray4(const FrameSet &set);
+    void benchmarkClear(const QSize &size);
+    void measure(const QString &kernel, const QSize &size, const QString &frames,
+                 const std::function<void(int)> &function);
+    // returns the number of sets the reference conversion is faster on
+    int compareWithReference() const;
+    bool readBaseline(QMap<QString, qint64> *baseline) const;
+    bool writeBaseline() const;
+
+    QString m_baselineFile;
+    bool m_update;
+    int m_threshold;
+    QList<FrameSet> m_recordings;
+    QList<QPair<QString, qint64> > m_results;
+};
+
+#endif // KERNELBENCHMARK_H
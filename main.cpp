@@ -1,13 +1,126 @@
 #include <QGuiApplication>
 #include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QQmlEngine>
+#include <QScopedPointer>
 #include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <string.h>
+#include "animationcache.h"
+#include "buttoninput.h"
+#include "framerecording.h"
+#include "frametracer.h"
+#include "frameverifier.h"
+#include "kernelbenchmark.h"
+#include "metricsserver.h"
+#include "monoimageprovider.h"
+#include "monoitems.h"
+#include "oleddisplay.h"
 #include "oledrenderer.h"
+#include "powermanager.h"
+#include "sharedframesource.h"
 #include "ssd1306driver.h"
+#include "ssd1306emulator.h"
+#include "temporalgrayscale.h"
+#include "threadtuning.h"
+
+// resident memory of the process from /proc/self/status, in KiB
+static QString processMemorySummary()
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly)) {
+        return QString("process memory: unknown");
+    }
+    QStringList fields;
+    const QList<QByteArray> lines = status.readAll().split('\n');
+    for (const QByteArray &line : lines) {
+        const QList<QByteArray> words = line.simplified().split(' ');
+        if ((words.size() >= 2) && ((words.first() == "VmRSS:") || (words.first() == "VmHWM:")
+                                    || (words.first() == "RssAnon:") || (words.first() == "RssFile:")
+                                    || (words.first() == "RssShmem:"))) {
+            fields.append(QString("%1=%2").arg(QString::fromLatin1(words.at(0).toLower()).remove(':'),
+                                               QString::fromLatin1(words.at(1))));
+        }
+    }
+    return "process memory (KiB): " + fields.join(' ');
+}
+
+static int replayRecording(const QString &fileName, bool maxSpeed, bool emulate, int bus, int address)
+{
+    FrameRecording recording;
+    if (!recording.open(fileName)) {
+        return -1;
+    }
+    if (emulate && !Ssd1306Emulator::supports(recording.controller())) {
+        qCritical() << "only SSD1306 and SSD1309 displays can be emulated";
+        return -1;
+    }
+
+    Ssd1306Emulator emulator;
+    Ssd1306Driver driver;
+    driver.setController(recording.controller());
+    const bool opened = emulate ? driver.openFile(recording.size(), emulator.open())
+                                : driver.openDevice(recording.size(), bus, address);
+    if (!opened) {
+        qCritical() << "cannot open OLED display";
+        return -1;
+    }
+    if ((driver.ramUnits() != recording.ramUnits()) || (driver.unitBytes() != recording.unitBytes())) {
+        qCritical() << "the recording does not match the GDDRAM layout of the display";
+        return -1;
+    }
+
+    FrameRecording::Frame frame;
+    const uint8_t *lastRam = nullptr;
+    int frames = 0;
+    const quint64 startBytes = driver.bytesWritten();
+    QElapsedTimer clock;
+    clock.start();
+    while (recording.next(&frame)) {
+        const qint64 wait = frame.timestamp - clock.nsecsElapsed();
+        if (!maxSpeed && (wait > 0)) {
+            QThread::usleep(static_cast<unsigned long>(wait / 1000));
+        }
+        driver.writeRam(frame.ram, frame.startLine, frame.plan);
+        lastRam = frame.ram;
+        ++frames;
+    }
+    const qint64 elapsed = clock.nsecsElapsed();
+    driver.close();
+
+    qDebug().noquote() << QString("replayed %1 frames in %2 ms, %3 bus bytes")
+                          .arg(frames).arg(elapsed / 1000000).arg(driver.bytesWritten() - startBytes);
+    qDebug().noquote() << driver.statistics().summary();
+
+    if (emulate && (lastRam != nullptr)) {
+        // the emulated GDDRAM has to end up with the last recorded image
+        emulator.close();
+        const QVector<uint8_t> gddram = emulator.gddram();
+        for (int page = 0; page < recording.ramUnits(); ++page) {
+            if (memcmp(gddram.constData() + page * 128, lastRam + page * recording.unitBytes(),
+                       static_cast<size_t>(recording.unitBytes())) != 0) {
+                qCritical() << "emulated GDDRAM differs from the recording in page" << page;
+                return 1;
+            }
+        }
+        qDebug() << "emulated GDDRAM matches the recording";
+    }
+
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
     QGuiApplication app(argc, argv);
     qApp->setApplicationName("QML OLED Renderer");
+    qmlRegisterUncreatableType<OledDisplay>("Oled", 1, 0, "OledDisplay", "use the oled context property");
+    qmlRegisterType<MonoRect>("Oled", 1, 0, "MonoRect");
+    qmlRegisterType<MonoText>("Oled", 1, 0, "MonoText");
+    qmlRegisterType<MonoBitmap>("Oled", 1, 0, "MonoBitmap");
+    qmlRegisterType<MonoBarGraph>("Oled", 1, 0, "MonoBarGraph");
 
     QCommandLineParser parser;
     parser.setApplicationDescription("Renders QML applications to a SSD1306 OLED display");
@@ -18,37 +131,408 @@ int main(int argc, char *argv[])
                           {{"h", "height"}, "OLED screen height", "height"},
                           {{"b", "bus"}, "I2C bus to which the OLED is connected", "bus"},
                           {{"a", "address"}, "I2C address of the OLED screen", "address"},
-                          {{"f", "fps"}, "Number of frames to render per second", "fps"}
+                          {{"f", "fps"}, "Number of frames to render per second", "fps"},
+                          {"gc-interval", "Collect JavaScript garbage in idle frame time at most every <ms> milliseconds", "ms"},
+                          {"stats", "Print frame statistics every <seconds> seconds", "seconds"},
+                          {"hw-scroll", "Show vertically moving content by changing the display start line"},
+                          {{"c", "controller"}, "Display controller: ssd1306, ssd1309, sh1106 or ssd1322", "controller"},
+                          {"grayscale", "Show <levels> grey levels (2 to 4) on monochrome panels by cycling bit planes", "levels"},
+                          {"subframe-rate", "Bit planes to show per second in grayscale mode", "hz"},
+                          {"dither", "Monochrome conversion: threshold, bayer, floyd-steinberg or atkinson", "mode"},
+                          {"loop-cache", "Replay a looping scene of <period> milliseconds, or a detected period for auto, without rendering it", "period"},
+                          {"record", "Record every frame sent to the display to <file>", "file"},
+                          {"replay", "Send the frames recorded in <file> to the display instead of rendering QML", "file"},
+                          {"max-speed", "Replay as fast as the bus allows instead of with the recorded timing"},
+                          {"emulate", "Send to an emulated SSD1306 instead of the I2C bus"},
+                          {"shm", "Show frames other processes write to the shared memory segment <name> instead of rendering QML", "name"},
+                          {"layer", "Draw another QML file on top, given as file.qml or file.qml@x,y,width,height[,z]", "layer"},
+                          {"image-cache", "Keep the converted image://mono/ images in <directory> across runs", "directory"},
+                          {"render-thread", "Render on a thread of its own and write to the display from another one"},
+                          {"render-cpu", "Pin rendering to CPU <cpu>", "cpu"},
+                          {"bus-cpu", "Pin the display writes to CPU <cpu>", "cpu"},
+                          {"rt-priority", "Render and write to the display with realtime <priority>, 1 to 99", "priority"},
+                          {"rt-policy", "Realtime scheduling policy: fifo or rr", "policy"},
+                          {"mlock", "Lock all memory and pre-fault the thread stacks"},
+                          {"bus-timeout", "Fail an I2C transfer that takes longer than <ms> milliseconds, 100 by default", "ms"},
+                          {"button", "Send key <key> to the scene from a GPIO line, given as chip:line=key, e.g. gpiochip0:17=Up", "button"},
+                          {"button-active-low", "Button lines are low while pressed"},
+                          {"button-debounce", "Debounce the button lines for <ms> milliseconds", "ms"},
+                          {"button-mock", "Read button events as \"<key> 1\" and \"<key> 0\" lines from <file> or FIFO", "file"},
+                          {"idle-dim", "Dim the panel after <seconds> without a change", "seconds"},
+                          {"idle-sleep", "Switch the panel off after <seconds> without a change", "seconds"},
+                          {"idle-contrast", "Contrast of the dimmed panel, 16 by default", "contrast"},
+                          {"idle-fade", "Dim with the controller's fade out instead of a lower contrast"},
+                          {"low-memory", "Keep GL buffers, caches and intermediate images small"},
+                          {"control", "Serve metrics and accept control commands on the Unix domain socket <path>", "path"},
+                          {"trace", "Trace the frame pipeline and write it to <file> on SIGUSR1 and on exit", "file"},
+                          {"trace-events", "Keep the last <count> trace events, 16384 by default", "count"},
+                          {"benchmark", "Measure the pixel kernels and compare them with the baseline"},
+                          {"benchmark-baseline", "Baseline results of this board in <file>", "file"},
+                          {"benchmark-update", "Write the measured results as the new baseline"},
+                          {"benchmark-threshold", "Fail when a kernel is more than <percent> slower, 10 by default", "percent"},
+                          {"benchmark-frames", "Also measure the kernels on the frames recorded in <file>", "file"},
+                          {"verify", "Check every fast display path against the reference conversion on emulated panels"},
+                          {"verify-frames", "Number of frames to verify, 120 by default", "frames"}
                       });
 
     parser.process(app);
 
+    int bus = parser.isSet("b") ? parser.value("b").toInt() : 2;
+    int address = parser.isSet("a") ? parser.value("a").toInt() : 0x3c;
+    if (parser.isSet("replay")) {
+        return replayRecording(parser.value("replay"), parser.isSet("max-speed"), parser.isSet("emulate"), bus, address);
+    }
+    if (parser.isSet("benchmark")) {
+        KernelBenchmark benchmark;
+        if (parser.isSet("benchmark-baseline")) {
+            benchmark.setBaselineFile(parser.value("benchmark-baseline"));
+        }
+        if (parser.isSet("benchmark-threshold")) {
+            benchmark.setThreshold(parser.value("benchmark-threshold").toInt());
+        }
+        benchmark.setUpdateBaseline(parser.isSet("benchmark-update"));
+        for (const QString &recording : parser.values("benchmark-frames")) {
+            if (!benchmark.addRecording(recording)) {
+                return -1;
+            }
+        }
+        return benchmark.run();
+    }
+
+    const bool sharedMemory = parser.isSet("shm");
     const QStringList args = parser.positionalArguments();
-    if (args.length() < 1) {
+    if ((args.length() < 1) && !sharedMemory) {
         qCritical() << "please specify a source file";
         return -1;
     }
-    QString sourceFile = args.first();
+    QString sourceFile = args.value(0);
 
     int width = parser.isSet("w") ? parser.value("w").toInt() : 128;
     int height = parser.isSet("h") ? parser.value("h").toInt() : 64;
-    int bus = parser.isSet("b") ? parser.value("b").toInt() : 2;
-    int address = parser.isSet("a") ? parser.value("a").toInt() : 0x3c;
     int fps = parser.isSet("f") ? parser.value("f").toInt() : 10;
+    int gcInterval = parser.isSet("gc-interval") ? parser.value("gc-interval").toInt() : 0;
+    int statsInterval = parser.isSet("stats") ? parser.value("stats").toInt() : 0;
+    int grayLevels = parser.isSet("grayscale") ? parser.value("grayscale").toInt() : 0;
+    int subFrameRate = parser.isSet("subframe-rate") ? parser.value("subframe-rate").toInt() : 120;
+    bool loopCache = parser.isSet("loop-cache");
+    int loopPeriod = (parser.value("loop-cache") == "auto") ? 0 : parser.value("loop-cache").toInt();
 
+    OledController::Type controller = OledController::SSD1306;
+    if (parser.isSet("c") && !OledController::parseType(parser.value("c"), &controller)) {
+        qCritical() << "unknown display controller" << parser.value("c");
+        return -1;
+    }
+    if ((grayLevels > 0) && (controller == OledController::SSD1322)) {
+        qCritical() << "grayscale mode is only available on monochrome panels";
+        return -1;
+    }
+    if (parser.isSet("emulate") && !Ssd1306Emulator::supports(controller)) {
+        qCritical() << "only SSD1306 and SSD1309 displays can be emulated";
+        return -1;
+    }
+    if ((grayLevels > 0) && loopCache) {
+        qCritical() << "the loop cache cannot be combined with grayscale mode";
+        return -1;
+    }
+    if (sharedMemory && ((grayLevels > 0) || loopCache || parser.isSet("layer"))) {
+        qCritical() << "grayscale mode, the loop cache and layers need rendered QML frames";
+        return -1;
+    }
+    const bool idle = parser.isSet("idle-dim") || parser.isSet("idle-sleep");
+    if (idle && loopCache) {
+        // both pause rendering, the loop cache while it replays a period
+        qCritical() << "idle power management cannot be combined with the loop cache";
+        return -1;
+    }
+    const bool lowMemory = parser.isSet("low-memory");
+    const bool renderThread = parser.isSet("render-thread");
+    if (renderThread && (sharedMemory || (grayLevels > 0) || loopCache)) {
+        // these pace the display from the main thread in step with the rendered frames
+        qCritical() << "the render thread cannot be combined with shm, grayscale mode or the loop cache";
+        return -1;
+    }
+
+    ThreadTuning renderTuning;
+    ThreadTuning busTuning;
+    if (parser.isSet("render-cpu") && !ThreadTuning::parseCpu(parser.value("render-cpu"), &renderTuning.cpu)) {
+        qCritical() << "invalid render CPU" << parser.value("render-cpu");
+        return -1;
+    }
+    if (parser.isSet("bus-cpu") && !ThreadTuning::parseCpu(parser.value("bus-cpu"), &busTuning.cpu)) {
+        qCritical() << "invalid bus CPU" << parser.value("bus-cpu");
+        return -1;
+    }
+    if (parser.isSet("rt-priority")) {
+        int policy = SCHED_FIFO;
+        if (parser.isSet("rt-policy") && !ThreadTuning::parsePolicy(parser.value("rt-policy"), &policy)) {
+            qCritical() << "unknown scheduling policy" << parser.value("rt-policy");
+            return -1;
+        }
+        renderTuning.policy = busTuning.policy = policy;
+        renderTuning.priority = busTuning.priority = qBound(1, parser.value("rt-priority").toInt(), 99);
+    }
+    renderTuning.prefaultStack = busTuning.prefaultStack = parser.isSet("mlock");
+    if (!renderThread && (renderTuning.cpu >= 0) && (busTuning.cpu >= 0) && (renderTuning.cpu != busTuning.cpu)) {
+        qCritical() << "rendering and display writes share the main thread without --render-thread";
+        return -1;
+    }
+    if (parser.isSet("mlock")) {
+        ThreadTuning::lockMemory();
+    }
+
+    // stage events of every frame go into a ring buffer, written as Chrome trace JSON
+    FrameTracer tracer;
+    if (parser.isSet("trace")) {
+        tracer.start(parser.isSet("trace-events") ? parser.value("trace-events").toInt() : 16384, parser.value("trace"));
+        if (!tracer.handleSignals()) {
+            return -1;
+        }
+    }
+
+    Ditherer::Mode ditherMode = Ditherer::Threshold;
+    if (parser.isSet("dither") && !Ditherer::parseMode(parser.value("dither"), &ditherMode)) {
+        qCritical() << "unknown dither mode" << parser.value("dither");
+        return -1;
+    }
+
+    if (parser.isSet("verify")) {
+        if (sharedMemory) {
+            qCritical() << "verification needs a QML scene";
+            return -1;
+        }
+        // without a frame count the run would never end
+        bool ok = true;
+        const int verifyFrames = parser.isSet("verify-frames") ? parser.value("verify-frames").toInt(&ok) : 120;
+        if (!ok || (verifyFrames <= 0)) {
+            qCritical() << "invalid number of frames to verify" << parser.value("verify-frames");
+            return -1;
+        }
+        FrameVerifier verifier(QSize(width, height), ditherMode);
+        verifier.setFrameCount(verifyFrames);
+        if (!verifier.addPath("damage", OledController::SSD1306, false, false)
+                || !verifier.addPath("full-frames", OledController::SSD1306, false, true)
+                || !verifier.addPath("hw-scroll", OledController::SSD1306, true, false)
+                || !verifier.addPath("ssd1309", OledController::SSD1309, true, false)) {
+            return -1;
+        }
+        OledDisplay display;
+        OledRenderer renderer;
+        renderer.setContextProperty("oled", &display);
+        renderer.addImageProvider("mono", new MonoImageProvider(QFileInfo(sourceFile).absolutePath(), ditherMode));
+        QObject::connect(&renderer, &OledRenderer::imageRendered, &verifier, &FrameVerifier::verifyFrame);
+        if (!renderer.loadQmlFile(sourceFile, QSize(width, height), 1.0, fps)) {
+            return -1;
+        }
+        verifier.setRootItem(renderer.rootItem());
+        renderer.start();
+        if (!renderer.isRunning()) {
+            return -1;
+        }
+        return app.exec();
+    }
+
+    Ssd1306Emulator emulator;
     Ssd1306Driver driver;
-    if (!driver.openDevice(QSize(width, height), bus, address)) {
+    driver.setController(controller);
+    driver.setDitherMode(ditherMode);
+    driver.setRecordingFile(parser.value("record"));
+    if (parser.isSet("bus-timeout")) {
+        driver.setTransferTimeout(parser.value("bus-timeout").toInt());
+    }
+    const bool opened = parser.isSet("emulate") ? driver.openFile(QSize(width, height), emulator.open())
+                                                : driver.openDevice(QSize(width, height), bus, address);
+    if (!opened) {
         qCritical() << "cannot open OLED display";
         return -1;
     }
-    QObject::connect(qApp, &QGuiApplication::aboutToQuit, &driver, &Ssd1306Driver::clearScreen);
+    driver.setHardwareScrollEnabled(parser.isSet("hw-scroll"));
+    // the display has to be cleared before the bus thread stops
+    QObject::connect(qApp, &QGuiApplication::aboutToQuit, &driver, &Ssd1306Driver::clearScreen,
+                     renderThread ? Qt::BlockingQueuedConnection : Qt::AutoConnection);
+
+    OledDisplay display;
+    QObject::connect(&display, &OledDisplay::contrastChanged, &driver, &Ssd1306Driver::setContrast);
+    QObject::connect(&display, &OledDisplay::invertedChanged, &driver, &Ssd1306Driver::setInverted);
+    QObject::connect(&display, &OledDisplay::poweredChanged, &driver, &Ssd1306Driver::setPowered);
+    // the fade state is read here and travels with the call when the driver is on the bus thread
+    const auto applyFade = [&display, &driver]() {
+        QMetaObject::invokeMethod(&driver, "setFade", Q_ARG(bool, display.fade() == OledDisplay::FadeOut),
+                                  Q_ARG(bool, display.fade() == OledDisplay::Blink), Q_ARG(int, display.fadeInterval()));
+    };
+    QObject::connect(&display, &OledDisplay::fadeChanged, applyFade);
+    QObject::connect(&display, &OledDisplay::fadeIntervalChanged, applyFade);
+
+    SharedFrameSource frameSource;
+    QScopedPointer<OledRenderer> renderer;
+    TemporalGrayscale grayscale;
+    QScopedPointer<AnimationCache> cache;
+    MonoImageProvider *monoImages = nullptr; // owned by the renderer's engine
+    if (sharedMemory) {
+        if (!frameSource.open(parser.value("shm"), QSize(width, height), driver.imageFormat())) {
+            return -1;
+        }
+        // packed from the segment, a frame overwritten meanwhile is dropped before it is sent
+        QObject::connect(&frameSource, &SharedFrameSource::frameReady, [&driver, &frameSource](const QImage &frame) {
+            driver.writeSharedImage(frame, [&frameSource]() { return frameSource.isFrameIntact(); });
+        });
+    } else {
+        renderer.reset(new OledRenderer);
+        renderer->setRenderThreadEnabled(renderThread);
+        renderer->setLowMemory(lowMemory);
+        renderer->setContextProperty("oled", &display);
+        monoImages = new MonoImageProvider(QFileInfo(sourceFile).absolutePath(), ditherMode);
+        monoImages->setCacheDirectory(parser.value("image-cache"));
+        if (lowMemory) {
+            // enough for the icons of a screen or two, the disk cache keeps the rest cheap
+            monoImages->setMemoryCacheLimit(128 * 1024);
+        }
+        renderer->addImageProvider("mono", monoImages);
+        if (grayLevels > 0) {
+            QObject::connect(renderer.data(), &OledRenderer::imageRendered, &grayscale, &TemporalGrayscale::setFrame);
+            QObject::connect(&grayscale, &TemporalGrayscale::planeReady,
+                             [&driver](const QImage &plane) { driver.writeImage(plane, plane.rect()); });
+            grayscale.start(grayLevels, subFrameRate);
+        } else if (loopCache) {
+            cache.reset(new AnimationCache(renderer.data(), &driver));
+            cache->start(fps, loopPeriod);
+        } else {
+            QObject::connect(renderer.data(), &OledRenderer::imageRendered, &driver, &Ssd1306Driver::writeImage);
+        }
+        renderer->setIdleGarbageCollection(gcInterval);
+        if (!renderer->loadQmlFile(sourceFile, QSize(width, height), 1.0, fps)) {
+            return -1;
+        }
+
+        const QStringList layers = parser.values("layer");
+        for (int i = 0; i < layers.size(); ++i) {
+            QString layerFile;
+            QRect region;
+            int z = i + 1;
+            if (!OledRenderer::parseLayer(layers.at(i), QSize(width, height), &layerFile, &region, &z)) {
+                qCritical() << "invalid layer" << layers.at(i);
+                return -1;
+            }
+            if (!renderer->addLayer(layerFile, region, z)) {
+                qCritical() << "cannot load layer" << layerFile;
+                return -1;
+            }
+        }
+        // the overlays are part of the first frame already
+        renderer->start();
+    }
 
-    OledRenderer renderer;
-    QObject::connect(&renderer, &OledRenderer::imageRendered, [&driver](const QImage &image) {
-       const auto mono = image.convertToFormat(QImage::Format_Mono, Qt::MonoOnly | Qt::ThresholdDither);
-       driver.writeImage(mono);
-    });
-    renderer.loadQmlFile(sourceFile, QSize(width, height), 1.0, fps);
+    // button edges become key events, their timestamp follows the frame to the end of its write
+    ButtonInput buttons;
+    if (parser.isSet("button") || parser.isSet("button-mock")) {
+        if (!renderer) {
+            qCritical() << "buttons need a QML scene";
+            return -1;
+        }
+        for (const QString &button : parser.values("button")) {
+            if (!buttons.addButton(button)) {
+                qCritical() << "invalid button" << button;
+                return -1;
+            }
+        }
+        buttons.setActiveLow(parser.isSet("button-active-low"));
+        buttons.setDebounce(parser.value("button-debounce").toInt());
+        if (!buttons.open() || (parser.isSet("button-mock") && !buttons.openMock(parser.value("button-mock")))) {
+            return -1;
+        }
+        QObject::connect(&buttons, &ButtonInput::buttonEvent, renderer.data(), &OledRenderer::sendKey);
+        QObject::connect(renderer.data(), &OledRenderer::inputRendered, &driver, &Ssd1306Driver::markInput);
+    }
 
-    return app.exec();
+    // the panel dims and sleeps while nothing changes, rendering pauses with it
+    PowerManager power(renderer.data(), &driver, &display);
+    if (idle) {
+        power.setDimTimeout(parser.value("idle-dim").toInt());
+        power.setSleepTimeout(parser.value("idle-sleep").toInt());
+        if (parser.isSet("idle-contrast")) {
+            power.setDimContrast(parser.value("idle-contrast").toInt());
+        }
+        power.setFadeEnabled(parser.isSet("idle-fade"));
+        QObject::connect(&power, &PowerManager::dimRequested, &driver, &Ssd1306Driver::dim);
+        QObject::connect(&power, &PowerManager::sleepRequested, &driver, &Ssd1306Driver::sleep);
+        QObject::connect(&power, &PowerManager::wakeRequested, &driver, &Ssd1306Driver::wake);
+        if (renderer) {
+            QObject::connect(renderer.data(), &OledRenderer::sceneChanged, &power, &PowerManager::activity);
+        } else {
+            QObject::connect(&frameSource, &SharedFrameSource::frameReady, &power, &PowerManager::activity);
+        }
+        QObject::connect(&buttons, &ButtonInput::buttonEvent, &power, &PowerManager::activity);
+        if (grayLevels > 0) {
+            // bit planes are only cycled while the panel is on
+            QObject::connect(&power, &PowerManager::sleepRequested, &grayscale, &TemporalGrayscale::stop);
+            QObject::connect(&power, &PowerManager::wakeRequested, [&grayscale, grayLevels, subFrameRate]() {
+                grayscale.start(grayLevels, subFrameRate);
+            });
+        }
+        power.start();
+    }
+
+    // metrics for scraping and live control while running
+    MetricsServer metricsServer(renderer.data(), &driver);
+    if (parser.isSet("control") && !metricsServer.listen(parser.value("control"))) {
+        return -1;
+    }
+
+    QTimer statsTimer;
+    if (statsInterval > 0) {
+        QObject::connect(&statsTimer, &QTimer::timeout, [&renderer, &driver, &grayscale, &cache, &frameSource, &power,
+                                                         monoImages, grayLevels, sharedMemory, idle]() {
+            if (renderer) {
+                qDebug().noquote() << renderer->statistics().summary();
+                qDebug().noquote() << monoImages->summary();
+                qDebug().noquote() << renderer->memorySummary();
+                if (renderer->renderThread() != nullptr) {
+                    qDebug().noquote() << QString("render thread: dropped=%1").arg(renderer->framesDropped());
+                }
+            }
+            qDebug().noquote() << driver.statistics().summary();
+            qDebug().noquote() << driver.busSummary();
+            qDebug().noquote() << processMemorySummary();
+            if (idle) {
+                qDebug().noquote() << power.summary();
+            }
+            if (grayLevels > 0) {
+                qDebug().noquote() << grayscale.summary();
+            }
+            if (cache) {
+                qDebug().noquote() << cache->summary();
+            }
+            if (sharedMemory) {
+                qDebug().noquote() << frameSource.summary();
+            }
+        });
+        statsTimer.start(statsInterval * 1000);
+    }
+
+    // frames arrive queued from the render thread, the bus is written from a thread of its own
+    QThread busThread;
+    busThread.setObjectName("bus");
+    if (renderThread) {
+        driver.moveToThread(&busThread);
+        busThread.start();
+        if (!renderTuning.isEmpty()) {
+            renderer->runOnRenderThread([renderTuning]() { renderTuning.apply("render"); });
+        }
+        if (!busTuning.isEmpty()) {
+            QTimer::singleShot(0, &driver, [busTuning]() { busTuning.apply("bus"); });
+        }
+    } else {
+        ThreadTuning mainTuning = renderTuning;
+        mainTuning.cpu = (renderTuning.cpu >= 0) ? renderTuning.cpu : busTuning.cpu;
+        if (!mainTuning.isEmpty()) {
+            mainTuning.apply("main");
+        }
+    }
+
+    const int result = app.exec();
+    busThread.quit();
+    busThread.wait();
+    if (parser.isSet("trace")) {
+        tracer.write();
+    }
+    return result;
 }
@@ -0,0 +1,154 @@
+#include "metricsserver.h"
+
+#include <QDebug>
+#include <QStringList>
+#include "oledrenderer.h"
+#include "ssd1306driver.h"
+
+namespace {
+// a client that sends no line ending cannot make the buffer grow without bound
+const qint64 MAX_LINE_LENGTH = 256;
+}
+
+MetricsServer::MetricsServer(OledRenderer *renderer, Ssd1306Driver *driver, QObject *parent)
+    : QObject(parent)
+    , m_renderer(renderer)
+    , m_driver(driver)
+{
+    connect(&m_server, &QLocalServer::newConnection, this, &MetricsServer::acceptConnections);
+}
+
+bool MetricsServer::listen(const QString &path)
+{
+    // only a socket left behind by a crashed instance is removed, not the one of a running one
+    QLocalSocket probe;
+    probe.connectToServer(path);
+    if (probe.waitForConnected(100)) {
+        qWarning() << "cannot listen on" << path << "another instance is using it";
+        return false;
+    }
+    QLocalServer::removeServer(path);
+    if (!m_server.listen(path)) {
+        qWarning() << "cannot listen on" << path << m_server.errorString();
+        return false;
+    }
+    return true;
+}
+
+void MetricsServer::acceptConnections()
+{
+    while (QLocalSocket *socket = m_server.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { readCommands(socket); });
+        connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+    }
+}
+
+void MetricsServer::readCommands(QLocalSocket *socket)
+{
+    while (socket->canReadLine()) {
+        const QString command = QString::fromUtf8(socket->readLine(MAX_LINE_LENGTH)).trimmed();
+        if (!command.isEmpty()) {
+            socket->write(execute(command));
+        }
+    }
+    if (socket->bytesAvailable() > MAX_LINE_LENGTH) {
+        socket->write("error line too long\n");
+        socket->disconnectFromServer();
+    }
+}
+
+QByteArray MetricsServer::execute(const QString &command)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    const QStringList words = command.split(' ', Qt::SkipEmptyParts);
+#else
+    const QStringList words = command.split(' ', QString::SkipEmptyParts);
+#endif
+    const QString name = words.first();
+    if ((name == "metrics") && (words.size() == 1)) {
+        return metrics();
+    }
+    if ((name == "refresh") && (words.size() == 1)) {
+        m_driver->refresh();
+        return "ok\n";
+    }
+    if (m_renderer == nullptr) {
+        return "error unknown command\n";
+    }
+
+    if ((name == "fps") && (words.size() == 2)) {
+        bool ok = false;
+        const int fps = words.at(1).toInt(&ok);
+        if (!ok || (fps <= 0) || (fps > 1000)) {
+            return "error invalid frame rate\n";
+        }
+        m_renderer->setFps(fps);
+        return "ok\n";
+    }
+    if (((name == "pause") || (name == "resume")) && (words.size() == 1)) {
+        m_renderer->setRenderingPaused(name == "pause", OledRenderer::ControlPause);
+        return "ok\n";
+    }
+    return "error unknown command\n";
+}
+
+QByteArray MetricsServer::metrics() const
+{
+    QByteArray out;
+    if (m_renderer != nullptr) {
+        appendMetric(&out, "oled_frames_rendered_total", "counter", "Frames rendered and handed to the display",
+                     m_renderer->framesRendered());
+        appendMetric(&out, "oled_frames_paused_total", "counter", "Frames not rendered while rendering was paused",
+                     m_renderer->framesSkipped());
+        appendMetric(&out, "oled_frames_dropped_total", "counter", "Frames dropped because the render thread was busy",
+                     m_renderer->framesDropped());
+        appendMetric(&out, "oled_fps", "gauge", "Frames rendered per second", m_renderer->fps());
+        appendMetric(&out, "oled_paused", "gauge", "Whether rendering is paused", m_renderer->isRenderingPaused() ? 1 : 0);
+    }
+    appendMetric(&out, "oled_bus_frames_total", "counter", "Frames written to the display", m_driver->framesWritten());
+    appendMetric(&out, "oled_bus_frames_skipped_total", "counter", "Frames skipped during the backoff after bus errors",
+                 m_driver->framesSkipped());
+    appendMetric(&out, "oled_bus_bytes_total", "counter", "Bytes written to the display bus", m_driver->bytesWritten());
+    appendMetric(&out, "oled_bus_seconds_total", "counter", "Time spent writing frames to the display bus",
+                 m_driver->statistics().sum(FrameStatistics::Transfer) / 1e9);
+    appendMetric(&out, "oled_bus_errors_total", "counter", "Failed display bus transfers", m_driver->busErrors());
+    appendMetric(&out, "oled_bus_retries_total", "counter", "Display bus transfers retried", m_driver->busRetries());
+    appendMetric(&out, "oled_bus_resyncs_total", "counter", "Frames sent completely to recover from bus errors",
+                 m_driver->busResyncs());
+
+    out += "# HELP oled_stage_seconds Latency of the frame stages over the last samples\n"
+           "# TYPE oled_stage_seconds summary\n";
+    if (m_renderer != nullptr) {
+        appendStages(&out, "renderer", m_renderer->statistics());
+    }
+    appendStages(&out, "driver", m_driver->statistics());
+    out += "# EOF\n";
+    return out;
+}
+
+void MetricsServer::appendMetric(QByteArray *out, const char *name, const char *type, const char *help, qreal value)
+{
+    *out += QString("# HELP %1 %2\n# TYPE %1 %3\n%1 %4\n")
+            .arg(name).arg(help).arg(type).arg(value, 0, 'g', 15).toUtf8();
+}
+
+void MetricsServer::appendStages(QByteArray *out, const char *source, const FrameStatistics &statistics)
+{
+    for (int i = 0; i < FrameStatistics::StageCount; ++i) {
+        const FrameStatistics::Stage stage = static_cast<FrameStatistics::Stage>(i);
+        const quint64 total = statistics.total(stage);
+        if (total == 0) {
+            continue;
+        }
+        const QString labels = QString("source=\"%1\",stage=\"%2\"").arg(source).arg(FrameStatistics::stageName(stage));
+        *out += QString("oled_stage_seconds{%1,quantile=\"0.5\"} %2\n"
+                        "oled_stage_seconds{%1,quantile=\"0.99\"} %3\n"
+                        "oled_stage_seconds_sum{%1} %4\n"
+                        "oled_stage_seconds_count{%1} %5\n")
+                .arg(labels)
+                .arg(statistics.quantile(stage, 0.5) / 1e9, 0, 'g', 6)
+                .arg(statistics.quantile(stage, 0.99) / 1e9, 0, 'g', 6)
+                .arg(statistics.sum(stage) / 1e9, 0, 'g', 15)
+                .arg(total).toUtf8();
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QByteArray>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QString>
+#include "framestatistics.h"
+
+class OledRenderer;
+class Ssd1306Driver;
+
+// Answers line commands on a Unix domain socket, for monitoring and for control while running:
+//   metrics       counters, gauges and stage latencies in the Prometheus text format, ended by "# EOF"
+//   fps <n>       renders <n> frames per second from now on
+//   pause/resume  stops and restarts rendering, animations keep running
+//   refresh       sends the next frame completely
+// Commands are answered with "ok" or "error <reason>". The counters are atomics the render and
+// bus threads update without locking, reading them never stalls a frame.
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    // renderer may be null when frames come from other processes
+    MetricsServer(OledRenderer *renderer, Ssd1306Driver *driver, QObject *parent = 0);
+
+    // replaces a socket left behind by a previous run
+    bool listen(const QString &path);
+
+    QByteArray metrics() const;
+
+private slots:
+    void acceptConnections();
+
+private:
+    void readCommands(QLocalSocket *socket);
+    QByteArray execute(const QString &command);
+
+    static void appendMetric(QByteArray *out, const char *name, const char *type, const char *help, qreal value);
+    static void appendStages(QByteArray *out, const char *source, const FrameStatistics &statistics);
+
+    OledRenderer *m_renderer;
+    Ssd1306Driver *m_driver;
+    QLocalServer m_server;
+};
+
+#endif // METRICSSERVER_H
@@ -0,0 +1,206 @@
+#include "monoimageprovider.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QPainter>
+#include <QSaveFile>
+#include <QStringList>
+#include <string.h>
+
+namespace {
+const quint32 CACHE_MAGIC = 0x4d4f4e4f; // "MONO"
+
+// the packed images of an icon heavy scene are a few KiB, this leaves plenty of room
+const int MEMORY_CACHE_BYTES = 1024 * 1024;
+
+QImage monoImage(const QSize &size)
+{
+    QImage image(size, QImage::Format_Mono);
+    image.setColorCount(2);
+    image.setColor(0, qRgba(0, 0, 0, 0));
+    image.setColor(1, qRgb(0, 0, 0));
+    return image;
+}
+}
+
+MonoImageProvider::MonoImageProvider(const QString &baseDirectory, Ditherer::Mode mode)
+    : QQuickImageProvider(QQuickImageProvider::Image)
+    , m_baseDirectory(baseDirectory)
+    , m_mode(mode)
+    , m_images(MEMORY_CACHE_BYTES)
+    , m_decoded(0)
+    , m_memoryHits(0)
+    , m_diskHits(0)
+{
+
+}
+
+void MonoImageProvider::setCacheDirectory(const QString &directory)
+{
+    m_cacheDirectory = directory;
+    if (!directory.isEmpty() && !QDir().mkpath(directory)) {
+        qWarning() << "cannot create image cache" << directory;
+        m_cacheDirectory.clear();
+    }
+}
+
+void MonoImageProvider::setMemoryCacheLimit(int bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_images.setMaxCost(bytes);
+}
+
+QImage MonoImageProvider::requestImage(const QString &id, QSize *size, const QSize &requestedSize)
+{
+    QString file = id;
+    Ditherer::Mode mode = m_mode;
+    const int query = id.indexOf('?');
+    if (query >= 0) {
+        file = id.left(query);
+        const QStringList options = id.mid(query + 1).split('&');
+        for (const QString &option : options) {
+            if (option.startsWith("dither=") && !Ditherer::parseMode(option.mid(7), &mode)) {
+                qWarning() << "unknown dither mode in" << id;
+            }
+        }
+    }
+
+    const QFileInfo info(QDir(m_baseDirectory), file);
+    const QString key = QString("%1|%2|%3x%4|%5")
+            .arg(info.absoluteFilePath())
+            .arg(info.lastModified().toMSecsSinceEpoch())
+            .arg(requestedSize.width())
+            .arg(requestedSize.height())
+            .arg(Ditherer::modeName(mode));
+
+    QMutexLocker locker(&m_mutex);
+    QImage image;
+    if (QImage *cached = m_images.object(key)) {
+        image = *cached;
+        ++m_memoryHits;
+    } else {
+        image = loadCached(key);
+        if (!image.isNull()) {
+            ++m_diskHits;
+        } else {
+            image = convert(info.absoluteFilePath(), requestedSize, mode);
+            if (image.isNull()) {
+                return image;
+            }
+            ++m_decoded;
+            saveCached(key, image);
+        }
+        m_images.insert(key, new QImage(image), static_cast<int>(image.sizeInBytes()));
+    }
+
+    if (size) {
+        *size = image.size();
+    }
+    return image;
+}
+
+QString MonoImageProvider::summary()
+{
+    QMutexLocker locker(&m_mutex);
+    return QString("mono images: decoded=%1 memory=%2 disk=%3")
+            .arg(m_decoded).arg(m_memoryHits).arg(m_diskHits);
+}
+
+QImage MonoImageProvider::convert(const QString &fileName, const QSize &requestedSize, Ditherer::Mode mode)
+{
+    QImage source(fileName);
+    if (source.isNull()) {
+        qWarning() << "cannot load" << fileName;
+        return QImage();
+    }
+
+    // a source size with one dimension left out keeps the aspect ratio
+    if ((requestedSize.width() > 0) && (requestedSize.height() > 0)) {
+        source = source.scaled(requestedSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    } else if (requestedSize.width() > 0) {
+        source = source.scaledToWidth(requestedSize.width(), Qt::SmoothTransformation);
+    } else if (requestedSize.height() > 0) {
+        source = source.scaledToHeight(requestedSize.height(), Qt::SmoothTransformation);
+    }
+    source = source.convertToFormat(QImage::Format_ARGB32);
+
+    // dither the image over white, then drop the pixels that are not opaque enough to show
+    QImage flat(source.size(), QImage::Format_RGB32);
+    flat.fill(Qt::white);
+    QPainter painter(&flat);
+    painter.drawImage(0, 0, source);
+    painter.end();
+
+    QImage image = monoImage(source.size());
+    Ditherer ditherer;
+    ditherer.setMode(mode);
+    ditherer.dither(flat, flat.width(), flat.height(), image.bits(), image.bytesPerLine());
+    for (int y = 0; y < source.height(); ++y) {
+        const QRgb *in = reinterpret_cast<const QRgb *>(source.constScanLine(y));
+        uchar *out = image.scanLine(y);
+        for (int x = 0; x < source.width(); ++x) {
+            if (qAlpha(in[x]) < 128) {
+                out[x >> 3] &= static_cast<uchar>(~(0x80 >> (x & 7)));
+            }
+        }
+    }
+    return image;
+}
+
+QImage MonoImageProvider::loadCached(const QString &key)
+{
+    if (m_cacheDirectory.isEmpty()) {
+        return QImage();
+    }
+    QFile file(cacheFileName(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QImage();
+    }
+
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    qint32 width = 0;
+    qint32 height = 0;
+    qint32 bytesPerLine = 0;
+    QByteArray bits;
+    stream >> magic >> width >> height >> bytesPerLine >> bits;
+    if ((stream.status() != QDataStream::Ok) || (magic != CACHE_MAGIC) || (width <= 0) || (height <= 0)) {
+        return QImage();
+    }
+
+    QImage image = monoImage(QSize(width, height));
+    if ((bytesPerLine != image.bytesPerLine()) || (bits.size() != image.sizeInBytes())) {
+        return QImage();
+    }
+    memcpy(image.bits(), bits.constData(), static_cast<size_t>(bits.size()));
+    return image;
+}
+
+void MonoImageProvider::saveCached(const QString &key, const QImage &image)
+{
+    if (m_cacheDirectory.isEmpty()) {
+        return;
+    }
+    // written to a temporary file first, a concurrent start never reads half a bitmap
+    QSaveFile file(cacheFileName(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << CACHE_MAGIC << qint32(image.width()) << qint32(image.height()) << qint32(image.bytesPerLine())
+           << QByteArray(reinterpret_cast<const char *>(image.constBits()), static_cast<int>(image.sizeInBytes()));
+    file.commit();
+}
+
+QString MonoImageProvider::cacheFileName(const QString &key) const
+{
+    const QByteArray hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return m_cacheDirectory + "/" + QString::fromLatin1(hash) + ".mono";
+}
@@ -0,0 +1,49 @@
+#ifndef MONOIMAGEPROVIDER_H
+#define MONOIMAGEPROVIDER_H
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QQuickImageProvider>
+#include <QSize>
+#include <QString>
+#include "ditherer.h"
+
+// Serves image://mono/<file>[?dither=<mode>] as 1 bpp images. Files are decoded, scaled to the
+// requested source size and dithered once, dark opaque pixels are lit and everything else is
+// transparent. Results are kept in memory and, with a cache directory, on disk so the next start
+// does not decode them again. Relative files are looked up from the base directory.
+//
+// Cache files are named after a hash of the file, its modification time, the requested size and
+// the dither mode, and hold a QDataStream with the magic "MONO", the width, height and
+// bytes per line as qint32 and the Format_Mono lines as a QByteArray.
+class MonoImageProvider : public QQuickImageProvider
+{
+public:
+    MonoImageProvider(const QString &baseDirectory, Ditherer::Mode mode);
+
+    void setCacheDirectory(const QString &directory);
+    // bytes of packed images kept in memory, 1 MiB by default
+    void setMemoryCacheLimit(int bytes);
+
+    QImage requestImage(const QString &id, QSize *size, const QSize &requestedSize) override;
+
+    QString summary();
+
+private:
+    QImage convert(const QString &fileName, const QSize &requestedSize, Ditherer::Mode mode);
+    QImage loadCached(const QString &key);
+    void saveCached(const QString &key, const QImage &image);
+    QString cacheFileName(const QString &key) const;
+
+    QString m_baseDirectory;
+    QString m_cacheDirectory;
+    Ditherer::Mode m_mode;
+    QMutex m_mutex; // images may be requested from loader threads
+    QCache<QString, QImage> m_images;
+    quint64 m_decoded;
+    quint64 m_memoryHits;
+    quint64 m_diskHits;
+};
+
+#endif // MONOIMAGEPROVIDER_H
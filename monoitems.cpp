@@ -0,0 +1,613 @@
+#include "monoitems.h"
+
+#include <QDebug>
+#include <QFontMetrics>
+#include <QPainter>
+#include <QQmlEngine>
+#include <QQuickImageProvider>
+#include <QtMath>
+#include <algorithm>
+#include <string.h>
+
+namespace {
+void initMonoImage(QImage *image, const QSize &size, QRgb unlit)
+{
+    *image = QImage(size, QImage::Format_Mono);
+    image->setColorCount(2);
+    image->setColor(0, unlit);
+    image->setColor(1, qRgb(0, 0, 0));
+}
+
+inline void setBit(uchar *line, int x)
+{
+    line[x >> 3] |= static_cast<uchar>(0x80 >> (x & 7));
+}
+}
+
+MonoCanvas::MonoCanvas(uchar *bits, int bytesPerLine, const QSize &size)
+    : m_bits(bits)
+    , m_bytesPerLine(bytesPerLine)
+    , m_bounds(QPoint(0, 0), size)
+    , m_clip(m_bounds)
+{
+
+}
+
+void MonoCanvas::setClip(const QRect &clip)
+{
+    m_clip = clip & m_bounds;
+}
+
+QRect MonoCanvas::clip() const
+{
+    return m_clip;
+}
+
+void MonoCanvas::fillRect(const QRect &rect, bool lit)
+{
+    const QRect area = rect & m_clip;
+    if (area.isEmpty()) {
+        return;
+    }
+
+    // partial bytes at both ends, whole bytes in between
+    const int first = area.left() >> 3;
+    const int last = area.right() >> 3;
+    const uchar firstMask = static_cast<uchar>(0xff >> (area.left() & 7));
+    const uchar lastMask = static_cast<uchar>(0xff << (7 - (area.right() & 7)));
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        uchar *line = m_bits + y * m_bytesPerLine;
+        if (first == last) {
+            const uchar mask = firstMask & lastMask;
+            line[first] = lit ? (line[first] | mask) : (line[first] & ~mask);
+            continue;
+        }
+        line[first] = lit ? (line[first] | firstMask) : (line[first] & ~firstMask);
+        if (last - first > 1) {
+            memset(line + first + 1, lit ? 0xff : 0x00, static_cast<size_t>(last - first - 1));
+        }
+        line[last] = lit ? (line[last] | lastMask) : (line[last] & ~lastMask);
+    }
+}
+
+void MonoCanvas::drawBitmap(const QPoint &position, const uchar *bits, int bytesPerLine, const QSize &size)
+{
+    const QRect area = QRect(position, size) & m_clip;
+    if (area.isEmpty()) {
+        return;
+    }
+
+    const int shift = position.x() & 7;
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        const uchar *in = bits + (y - position.y()) * bytesPerLine;
+        uchar *out = m_bits + y * m_bytesPerLine;
+        for (int byte = 0; byte < (size.width() + 7) / 8; ++byte) {
+            const uchar value = in[byte];
+            if (value == 0) {
+                continue;
+            }
+            const int x = position.x() + byte * 8;
+            if ((x >= area.left()) && (x + 7 <= area.right())) {
+                out[x >> 3] |= static_cast<uchar>(value >> shift);
+                if (shift != 0) {
+                    out[(x >> 3) + 1] |= static_cast<uchar>(value << (8 - shift));
+                }
+                continue;
+            }
+            // bytes cut by the clip go pixel by pixel
+            for (int bit = 0; bit < 8; ++bit) {
+                if ((value & (0x80 >> bit)) && (x + bit >= area.left()) && (x + bit <= area.right())) {
+                    setBit(out, x + bit);
+                }
+            }
+        }
+    }
+}
+
+void MonoCanvas::drawBitmap(const QPoint &position, const QImage &bitmap)
+{
+    drawBitmap(position, bitmap.constBits(), bitmap.bytesPerLine(), bitmap.size());
+}
+
+MonoItem::MonoItem(QQuickItem *parent)
+    : QQuickPaintedItem(parent)
+{
+    setAntialiasing(false);
+}
+
+void MonoItem::paint(QPainter *painter)
+{
+    const QSize size(qCeil(width()), qCeil(height()));
+    if (size.isEmpty()) {
+        return;
+    }
+    // drawn with the same code as on the CPU path, unlit pixels stay transparent
+    if (m_bitmap.size() != size) {
+        initMonoImage(&m_bitmap, size, qRgba(0, 0, 0, 0));
+    }
+    m_bitmap.fill(0);
+    MonoCanvas canvas(m_bitmap.bits(), m_bitmap.bytesPerLine(), size);
+    paintMono(canvas, QPoint(0, 0));
+    painter->drawImage(0, 0, m_bitmap);
+}
+
+MonoRect::MonoRect(QQuickItem *parent)
+    : MonoItem(parent)
+    , m_filled(true)
+    , m_borderWidth(1)
+{
+
+}
+
+bool MonoRect::isFilled() const
+{
+    return m_filled;
+}
+
+void MonoRect::setFilled(bool filled)
+{
+    if (m_filled == filled) {
+        return;
+    }
+    m_filled = filled;
+    emit filledChanged();
+    update();
+}
+
+int MonoRect::borderWidth() const
+{
+    return m_borderWidth;
+}
+
+void MonoRect::setBorderWidth(int width)
+{
+    if (m_borderWidth == width) {
+        return;
+    }
+    m_borderWidth = width;
+    emit borderWidthChanged();
+    update();
+}
+
+void MonoRect::paintMono(MonoCanvas &canvas, const QPoint &origin)
+{
+    const QRect rect(origin, QSize(qCeil(width()), qCeil(height())));
+    if (m_filled) {
+        canvas.fillRect(rect);
+        return;
+    }
+
+    const int border = qMin(m_borderWidth, qMin(rect.width(), rect.height()) / 2);
+    canvas.fillRect(QRect(rect.left(), rect.top(), rect.width(), border));
+    canvas.fillRect(QRect(rect.left(), rect.bottom() - border + 1, rect.width(), border));
+    canvas.fillRect(QRect(rect.left(), rect.top() + border, border, rect.height() - 2 * border));
+    canvas.fillRect(QRect(rect.right() - border + 1, rect.top() + border, border, rect.height() - 2 * border));
+}
+
+MonoFont *MonoFont::get(const QFont &font)
+{
+    // fonts stay cached for the lifetime of the process, scenes only use a handful
+    static QHash<QString, MonoFont *> fonts;
+    MonoFont *&monoFont = fonts[font.key()];
+    if (monoFont == nullptr) {
+        monoFont = new MonoFont(font);
+    }
+    return monoFont;
+}
+
+MonoFont::MonoFont(const QFont &font)
+    : m_font(font)
+{
+    m_font.setStyleStrategy(QFont::NoAntialias);
+    const QFontMetrics metrics(m_font);
+    m_ascent = metrics.ascent();
+    m_height = metrics.height();
+}
+
+const MonoFont::Glyph &MonoFont::glyph(QChar character)
+{
+    auto it = m_glyphs.find(character);
+    if (it != m_glyphs.end()) {
+        return *it;
+    }
+
+    // rasterise the glyph with its overhang on both sides and keep the dark pixels
+    const QFontMetrics metrics(m_font);
+    Glyph glyph;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    glyph.advance = metrics.horizontalAdvance(character);
+#else
+    glyph.advance = metrics.width(character);
+#endif
+    glyph.left = qMin(0, metrics.leftBearing(character));
+    const int right = qMax(glyph.advance, glyph.advance - metrics.rightBearing(character));
+    const QSize size(qMax(1, right - glyph.left), m_height);
+
+    QImage rendered(size, QImage::Format_RGB32);
+    rendered.fill(Qt::white);
+    QPainter painter(&rendered);
+    painter.setFont(m_font);
+    painter.setPen(Qt::black);
+    painter.drawText(-glyph.left, m_ascent, QString(character));
+    painter.end();
+
+    initMonoImage(&glyph.bitmap, size, qRgb(255, 255, 255));
+    glyph.bitmap.fill(0);
+    for (int y = 0; y < size.height(); ++y) {
+        const QRgb *in = reinterpret_cast<const QRgb *>(rendered.constScanLine(y));
+        uchar *out = glyph.bitmap.scanLine(y);
+        for (int x = 0; x < size.width(); ++x) {
+            if (qGray(in[x]) < 128) {
+                setBit(out, x);
+            }
+        }
+    }
+
+    return *m_glyphs.insert(character, glyph);
+}
+
+int MonoFont::ascent() const
+{
+    return m_ascent;
+}
+
+int MonoFont::height() const
+{
+    return m_height;
+}
+
+int MonoFont::width(const QString &text)
+{
+    int width = 0;
+    for (QChar character : text) {
+        width += glyph(character).advance;
+    }
+    return width;
+}
+
+MonoText::MonoText(QQuickItem *parent)
+    : MonoItem(parent)
+    , m_monoFont(MonoFont::get(m_font))
+{
+    updateImplicitSize();
+}
+
+QString MonoText::text() const
+{
+    return m_text;
+}
+
+void MonoText::setText(const QString &text)
+{
+    if (m_text == text) {
+        return;
+    }
+    m_text = text;
+    updateImplicitSize();
+    emit textChanged();
+    update();
+}
+
+QFont MonoText::font() const
+{
+    return m_font;
+}
+
+void MonoText::setFont(const QFont &font)
+{
+    if (m_font == font) {
+        return;
+    }
+    m_font = font;
+    m_monoFont = MonoFont::get(font);
+    updateImplicitSize();
+    emit fontChanged();
+    update();
+}
+
+void MonoText::paintMono(MonoCanvas &canvas, const QPoint &origin)
+{
+    int x = origin.x();
+    for (QChar character : m_text) {
+        const MonoFont::Glyph &glyph = m_monoFont->glyph(character);
+        canvas.drawBitmap(QPoint(x + glyph.left, origin.y()), glyph.bitmap);
+        x += glyph.advance;
+    }
+}
+
+void MonoText::updateImplicitSize()
+{
+    setImplicitSize(m_monoFont->width(m_text), m_monoFont->height());
+}
+
+MonoBitmap::MonoBitmap(QQuickItem *parent)
+    : MonoItem(parent)
+    , m_threshold(128)
+{
+
+}
+
+QUrl MonoBitmap::source() const
+{
+    return m_source;
+}
+
+void MonoBitmap::setSource(const QUrl &source)
+{
+    if (m_source == source) {
+        return;
+    }
+    m_source = source;
+    load();
+    emit sourceChanged();
+}
+
+int MonoBitmap::threshold() const
+{
+    return m_threshold;
+}
+
+void MonoBitmap::setThreshold(int threshold)
+{
+    if (m_threshold == threshold) {
+        return;
+    }
+    m_threshold = threshold;
+    load();
+    emit thresholdChanged();
+}
+
+void MonoBitmap::paintMono(MonoCanvas &canvas, const QPoint &origin)
+{
+    if (!m_bitmap.isNull()) {
+        canvas.drawBitmap(origin, m_bitmap);
+    }
+}
+
+QImage MonoBitmap::requestImage() const
+{
+    QQmlEngine *engine = qmlEngine(this);
+    QQmlImageProviderBase *provider = (engine != nullptr) ? engine->imageProvider(m_source.host()) : nullptr;
+    if ((provider == nullptr) || (provider->imageType() != QQmlImageProviderBase::Image)) {
+        return QImage();
+    }
+    // the id is everything after image://<provider>/, queries included
+    const QString url = m_source.toString();
+    const QString id = url.mid(url.indexOf('/', QString("image://").size()) + 1);
+    QSize size;
+    return static_cast<QQuickImageProvider *>(provider)->requestImage(id, &size, QSize());
+}
+
+bool MonoBitmap::isLit(QRgb color) const
+{
+    return (qAlpha(color) >= 128) && (qGray(color) < m_threshold);
+}
+
+void MonoBitmap::load()
+{
+    m_bitmap = QImage();
+    if (!m_source.isEmpty()) {
+        QImage image;
+        if (m_source.scheme() == "image") {
+            image = requestImage();
+        } else {
+            image = QImage((m_source.scheme() == "qrc") ? ":" + m_source.path() : m_source.toLocalFile());
+        }
+        if (image.isNull()) {
+            qWarning() << "cannot load" << m_source;
+        } else if ((image.format() == QImage::Format_Mono) && (image.colorCount() == 2)
+                   && isLit(image.color(1)) && !isLit(image.color(0))) {
+            // 1 bpp images with set bits lit, like those of image://mono/, are shared as they are
+            m_bitmap = image;
+        } else {
+            image = image.convertToFormat(QImage::Format_ARGB32);
+            initMonoImage(&m_bitmap, image.size(), qRgb(255, 255, 255));
+            m_bitmap.fill(0);
+            for (int y = 0; y < image.height(); ++y) {
+                const QRgb *in = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+                uchar *out = m_bitmap.scanLine(y);
+                for (int x = 0; x < image.width(); ++x) {
+                    if (isLit(in[x])) {
+                        setBit(out, x);
+                    }
+                }
+            }
+        }
+    }
+
+    setImplicitSize(m_bitmap.width(), m_bitmap.height());
+    update();
+}
+
+MonoBarGraph::MonoBarGraph(QQuickItem *parent)
+    : MonoItem(parent)
+    , m_minimum(0.0)
+    , m_maximum(1.0)
+    , m_spacing(1)
+{
+
+}
+
+QList<qreal> MonoBarGraph::values() const
+{
+    return m_values;
+}
+
+void MonoBarGraph::setValues(const QList<qreal> &values)
+{
+    if (m_values == values) {
+        return;
+    }
+    m_values = values;
+    emit valuesChanged();
+    update();
+}
+
+qreal MonoBarGraph::minimum() const
+{
+    return m_minimum;
+}
+
+void MonoBarGraph::setMinimum(qreal minimum)
+{
+    if (m_minimum == minimum) {
+        return;
+    }
+    m_minimum = minimum;
+    emit rangeChanged();
+    update();
+}
+
+qreal MonoBarGraph::maximum() const
+{
+    return m_maximum;
+}
+
+void MonoBarGraph::setMaximum(qreal maximum)
+{
+    if (m_maximum == maximum) {
+        return;
+    }
+    m_maximum = maximum;
+    emit rangeChanged();
+    update();
+}
+
+int MonoBarGraph::spacing() const
+{
+    return m_spacing;
+}
+
+void MonoBarGraph::setSpacing(int spacing)
+{
+    if (m_spacing == spacing) {
+        return;
+    }
+    m_spacing = spacing;
+    emit spacingChanged();
+    update();
+}
+
+void MonoBarGraph::paintMono(MonoCanvas &canvas, const QPoint &origin)
+{
+    const int count = m_values.size();
+    if ((count == 0) || (m_maximum <= m_minimum)) {
+        return;
+    }
+
+    const int graphWidth = qCeil(width());
+    const int graphHeight = qCeil(height());
+    const int barWidth = qMax(1, (graphWidth - m_spacing * (count - 1)) / count);
+    for (int i = 0; i < count; ++i) {
+        const qreal ratio = qBound(0.0, (m_values.at(i) - m_minimum) / (m_maximum - m_minimum), 1.0);
+        const int barHeight = qRound(ratio * graphHeight);
+        const int x = origin.x() + i * (barWidth + m_spacing);
+        canvas.fillRect(QRect(x, origin.y() + graphHeight - barHeight, barWidth, barHeight));
+    }
+}
+
+MonoScene::MonoScene()
+{
+
+}
+
+bool MonoScene::render(QQuickItem *root, const QSize &size)
+{
+    m_placements.clear();
+    if (!collect(root, QRect(QPoint(0, 0), size))) {
+        return false;
+    }
+
+    if (m_next.size() != size) {
+        initMonoImage(&m_next, size, qRgb(255, 255, 255));
+    }
+    m_next.fill(0);
+    MonoCanvas canvas(m_next.bits(), m_next.bytesPerLine(), size);
+    for (const Placement &placement : m_placements) {
+        canvas.setClip(placement.clip);
+        placement.item->paintMono(canvas, placement.origin);
+    }
+
+    // the lines that differ from the previous frame
+    m_damage = QRect(QPoint(0, 0), size);
+    if (m_image.size() == size) {
+        int first = -1;
+        int last = -1;
+        const size_t bytes = static_cast<size_t>((size.width() + 7) / 8);
+        for (int y = 0; y < size.height(); ++y) {
+            if (memcmp(m_image.constScanLine(y), m_next.constScanLine(y), bytes) != 0) {
+                first = (first < 0) ? y : first;
+                last = y;
+            }
+        }
+        m_damage = (first < 0) ? QRect() : QRect(0, first, size.width(), last - first + 1);
+    }
+    m_image.swap(m_next);
+    return true;
+}
+
+void MonoScene::reset()
+{
+    m_image = QImage();
+}
+
+const QImage &MonoScene::image() const
+{
+    return m_image;
+}
+
+QRect MonoScene::damage() const
+{
+    return m_damage;
+}
+
+qint64 MonoScene::sizeInBytes() const
+{
+    return m_image.sizeInBytes() + m_next.sizeInBytes();
+}
+
+bool MonoScene::collect(QQuickItem *item, const QRect &clip)
+{
+    if (!item->isVisible() || (item->opacity() <= 0.0)) {
+        return true;
+    }
+    if (item->opacity() < 1.0) {
+        return false;
+    }
+
+    // only translations to whole pixels can be drawn without the scene graph
+    const QPointF position = item->mapToScene(QPointF(0, 0));
+    const QPoint origin = position.toPoint();
+    if ((item->mapRectToScene(QRectF(0, 0, 1, 1)).size() != QSizeF(1, 1)) || (QPointF(origin) != position)) {
+        return false;
+    }
+
+    MonoItem *monoItem = qobject_cast<MonoItem *>(item);
+    if ((monoItem == nullptr) && (item->flags() & QQuickItem::ItemHasContents)) {
+        return false;
+    }
+
+    const QRect bounds(origin, QSize(qCeil(item->width()), qCeil(item->height())));
+    const QRect childClip = item->clip() ? (clip & bounds) : clip;
+    QList<QQuickItem *> children = item->childItems();
+    std::stable_sort(children.begin(), children.end(),
+                     [](const QQuickItem *a, const QQuickItem *b) { return a->z() < b->z(); });
+
+    // children with a negative z are drawn below their parent
+    int child = 0;
+    for (; (child < children.size()) && (children.at(child)->z() < 0.0); ++child) {
+        if (!collect(children.at(child), childClip)) {
+            return false;
+        }
+    }
+    if (monoItem != nullptr) {
+        const Placement placement = {monoItem, origin, clip & bounds};
+        m_placements.append(placement);
+    }
+    for (; child < children.size(); ++child) {
+        if (!collect(children.at(child), childClip)) {
+            return false;
+        }
+    }
+    return true;
+}
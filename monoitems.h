@@ -0,0 +1,236 @@
+#ifndef MONOITEMS_H
+#define MONOITEMS_H
+
+#include <QFont>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QQuickItem>
+#include <QQuickPaintedItem>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QUrl>
+#include <QVector>
+
+// 1 bpp drawing target on Format_Mono scanlines, MSB first, a set bit is a lit pixel
+class MonoCanvas
+{
+public:
+    MonoCanvas(uchar *bits, int bytesPerLine, const QSize &size);
+
+    void setClip(const QRect &clip);
+    QRect clip() const;
+
+    void fillRect(const QRect &rect, bool lit = true);
+    // lights the pixels that are set in the bitmap, it has the same layout as the canvas
+    void drawBitmap(const QPoint &position, const uchar *bits, int bytesPerLine, const QSize &size);
+    void drawBitmap(const QPoint &position, const QImage &bitmap);
+
+private:
+    uchar *m_bits;
+    int m_bytesPerLine;
+    QRect m_bounds;
+    QRect m_clip;
+};
+
+// Base of the Mono* QML types. They draw whole pixels and are lit where dark content would
+// be, so they look the same whether the scene goes through the scene graph or, when it is
+// made of nothing else, straight into the panel frame through MonoScene.
+class MonoItem : public QQuickPaintedItem
+{
+    Q_OBJECT
+public:
+    explicit MonoItem(QQuickItem *parent = nullptr);
+
+    // draws the item with its top left corner at origin
+    virtual void paintMono(MonoCanvas &canvas, const QPoint &origin) = 0;
+
+    void paint(QPainter *painter) override;
+
+private:
+    QImage m_bitmap;
+};
+
+class MonoRect : public MonoItem
+{
+    Q_OBJECT
+    Q_PROPERTY(bool filled READ isFilled WRITE setFilled NOTIFY filledChanged)
+    Q_PROPERTY(int borderWidth READ borderWidth WRITE setBorderWidth NOTIFY borderWidthChanged)
+
+public:
+    explicit MonoRect(QQuickItem *parent = nullptr);
+
+    bool isFilled() const;
+    void setFilled(bool filled);
+    int borderWidth() const;
+    void setBorderWidth(int width);
+
+    void paintMono(MonoCanvas &canvas, const QPoint &origin) override;
+
+signals:
+    void filledChanged();
+    void borderWidthChanged();
+
+private:
+    bool m_filled;
+    int m_borderWidth;
+};
+
+// Glyphs rasterised once per font without antialiasing and kept as 1 bpp bitmaps
+class MonoFont
+{
+public:
+    struct Glyph
+    {
+        QImage bitmap; // Format_Mono, one line cell high, 1 = lit
+        int left;      // bitmap offset from the pen position
+        int advance;
+    };
+
+    static MonoFont *get(const QFont &font);
+
+    const Glyph &glyph(QChar character);
+    int ascent() const;
+    int height() const;
+    int width(const QString &text);
+
+private:
+    explicit MonoFont(const QFont &font);
+
+    QFont m_font;
+    int m_ascent;
+    int m_height;
+    QHash<QChar, Glyph> m_glyphs;
+};
+
+class MonoText : public MonoItem
+{
+    Q_OBJECT
+    Q_PROPERTY(QString text READ text WRITE setText NOTIFY textChanged)
+    Q_PROPERTY(QFont font READ font WRITE setFont NOTIFY fontChanged)
+
+public:
+    explicit MonoText(QQuickItem *parent = nullptr);
+
+    QString text() const;
+    void setText(const QString &text);
+    QFont font() const;
+    void setFont(const QFont &font);
+
+    void paintMono(MonoCanvas &canvas, const QPoint &origin) override;
+
+signals:
+    void textChanged();
+    void fontChanged();
+
+private:
+    void updateImplicitSize();
+
+    QString m_text;
+    QFont m_font;
+    MonoFont *m_monoFont;
+};
+
+// Shows an image thresholded once when it is loaded, dark opaque pixels are lit
+class MonoBitmap : public MonoItem
+{
+    Q_OBJECT
+    Q_PROPERTY(QUrl source READ source WRITE setSource NOTIFY sourceChanged)
+    Q_PROPERTY(int threshold READ threshold WRITE setThreshold NOTIFY thresholdChanged)
+
+public:
+    explicit MonoBitmap(QQuickItem *parent = nullptr);
+
+    QUrl source() const;
+    void setSource(const QUrl &source);
+    int threshold() const;
+    void setThreshold(int threshold);
+
+    void paintMono(MonoCanvas &canvas, const QPoint &origin) override;
+
+signals:
+    void sourceChanged();
+    void thresholdChanged();
+
+private:
+    // asks the engine's provider for an image:// source, image://mono/ keeps its 1 bpp cache
+    QImage requestImage() const;
+    bool isLit(QRgb color) const;
+    void load();
+
+    QUrl m_source;
+    int m_threshold;
+    QImage m_bitmap;
+};
+
+// Vertical bars from the bottom edge, one per value between minimum and maximum
+class MonoBarGraph : public MonoItem
+{
+    Q_OBJECT
+    Q_PROPERTY(QList<qreal> values READ values WRITE setValues NOTIFY valuesChanged)
+    Q_PROPERTY(qreal minimum READ minimum WRITE setMinimum NOTIFY rangeChanged)
+    Q_PROPERTY(qreal maximum READ maximum WRITE setMaximum NOTIFY rangeChanged)
+    Q_PROPERTY(int spacing READ spacing WRITE setSpacing NOTIFY spacingChanged)
+
+public:
+    explicit MonoBarGraph(QQuickItem *parent = nullptr);
+
+    QList<qreal> values() const;
+    void setValues(const QList<qreal> &values);
+    qreal minimum() const;
+    void setMinimum(qreal minimum);
+    qreal maximum() const;
+    void setMaximum(qreal maximum);
+    int spacing() const;
+    void setSpacing(int spacing);
+
+    void paintMono(MonoCanvas &canvas, const QPoint &origin) override;
+
+signals:
+    void valuesChanged();
+    void rangeChanged();
+    void spacingChanged();
+
+private:
+    QList<qreal> m_values;
+    qreal m_minimum;
+    qreal m_maximum;
+    int m_spacing;
+};
+
+// Draws scenes that consist of Mono* items and content-less containers on the CPU. Items must
+// sit on whole pixels without rotation, scaling or partial opacity, anything else needs the
+// scene graph and makes render() return false.
+class MonoScene
+{
+public:
+    MonoScene();
+
+    bool render(QQuickItem *root, const QSize &size);
+    // makes the next render() damage the whole frame
+    void reset();
+
+    // the last frame in Format_Mono and the lines that changed in it
+    const QImage &image() const;
+    QRect damage() const;
+    // memory of the frame and the one it is drawn into
+    qint64 sizeInBytes() const;
+
+private:
+    struct Placement
+    {
+        MonoItem *item;
+        QPoint origin;
+        QRect clip;
+    };
+
+    bool collect(QQuickItem *item, const QRect &clip);
+
+    QVector<Placement> m_placements;
+    QImage m_image;
+    QImage m_next;
+    QRect m_damage;
+};
+
+#endif // MONOITEMS_H
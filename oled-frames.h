@@ -0,0 +1,149 @@
+#ifndef OLED_FRAMES_H
+#define OLED_FRAMES_H
+
+/*
+ * Shared memory frame ingestion for qml-oled-renderer.
+ *
+ * Started with --shm <name>, the renderer creates the POSIX shared memory segment /<name> and
+ * shows whatever complete frame other processes published last. Frames go through the same
+ * packing, dirty diffing and transfer planning as rendered QML, straight from the segment.
+ * The renderer holds an flock() on the segment while it runs, another renderer started with
+ * the same name fails instead of taking over a live segment.
+ *
+ * The segment starts with struct oled_frames, followed by slot_count frame slots of slot_bytes
+ * each at slot_offset. Frames have the size and pixel format given in the header:
+ *
+ *   OLED_FRAMES_MONO   1 bpp, most significant bit first, a set bit is a lit pixel
+ *   OLED_FRAMES_RGB32  0xffRRGGBB, dark pixels are lit as with QML content
+ *
+ * Any number of producers may publish. Each frame claims the next slot, the sequence of a slot
+ * is 0 while it is written and the claim number + 1 once the frame is complete. The doorbell
+ * is a futex word that wakes the renderer. A frame that is overwritten while the renderer packs
+ * it is dropped before it reaches the panel and the newer frame is taken right away, which needs
+ * a producer to run slot_count - 1 frames ahead of the display.
+ *
+ *     struct oled_frames *frames;
+ *     size_t size;
+ *     uint32_t claim;
+ *     if (oled_frames_open("oled", &frames, &size) == 0) {
+ *         uint8_t *bits = oled_frames_begin(frames, &claim);
+ *         draw(bits, frames->width, frames->height, frames->bytes_per_line);
+ *         oled_frames_publish(frames, claim);
+ *         oled_frames_close(frames, size);
+ *     }
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define OLED_FRAMES_MAGIC   0x5246454cu /* "LEFR" */
+#define OLED_FRAMES_VERSION 1u
+#define OLED_FRAMES_SLOTS   4u
+
+enum oled_frames_format {
+    OLED_FRAMES_MONO = 1,
+    OLED_FRAMES_RGB32 = 2
+};
+
+struct oled_frames_slot {
+    uint32_t sequence;
+    uint32_t reserved;
+};
+
+struct oled_frames {
+    uint32_t magic;          /* written last by the renderer once the header is valid */
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;         /* enum oled_frames_format */
+    uint32_t bytes_per_line;
+    uint32_t slot_count;
+    uint32_t slot_offset;    /* from the start of the segment */
+    uint32_t slot_bytes;
+    uint32_t claimed;        /* next claim number */
+    uint32_t doorbell;       /* futex word, incremented for every published frame */
+    uint32_t waiting;        /* non-zero while the renderer sleeps on the doorbell */
+    struct oled_frames_slot slots[OLED_FRAMES_SLOTS];
+};
+
+static inline uint8_t *oled_frames_slot_bits(struct oled_frames *frames, uint32_t slot)
+{
+    return (uint8_t *)frames + frames->slot_offset + (size_t)slot * frames->slot_bytes;
+}
+
+/* maps the segment created by the renderer, returns 0 or a negative errno */
+static inline int oled_frames_open(const char *name, struct oled_frames **frames, size_t *size)
+{
+    char path[256];
+    struct stat st;
+    void *map;
+    int file;
+    size_t i;
+
+    path[0] = '/';
+    for (i = 0; (name[i] != '\0') && (i + 2 < sizeof(path)); ++i) {
+        path[i + 1] = name[i];
+    }
+    path[i + 1] = '\0';
+
+    if ((file = shm_open(path, O_RDWR, 0)) < 0) {
+        return -errno;
+    }
+    if ((fstat(file, &st) < 0) || ((size_t)st.st_size < sizeof(struct oled_frames))) {
+        close(file);
+        return -EINVAL;
+    }
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    close(file);
+    if (map == MAP_FAILED) {
+        return -errno;
+    }
+
+    *frames = (struct oled_frames *)map;
+    *size = (size_t)st.st_size;
+    if ((__atomic_load_n(&(*frames)->magic, __ATOMIC_ACQUIRE) != OLED_FRAMES_MAGIC)
+            || ((*frames)->version != OLED_FRAMES_VERSION)) {
+        munmap(map, *size);
+        return -EPROTO;
+    }
+    return 0;
+}
+
+static inline void oled_frames_close(struct oled_frames *frames, size_t size)
+{
+    munmap(frames, size);
+}
+
+/* claims a slot and returns the frame to draw into */
+static inline uint8_t *oled_frames_begin(struct oled_frames *frames, uint32_t *claim)
+{
+    uint32_t slot;
+
+    *claim = __atomic_fetch_add(&frames->claimed, 1u, __ATOMIC_RELAXED);
+    slot = *claim % frames->slot_count;
+    __atomic_store_n(&frames->slots[slot].sequence, 0u, __ATOMIC_RELAXED);
+    /* the renderer must see the slot as busy before any pixel changes */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return oled_frames_slot_bits(frames, slot);
+}
+
+/* completes the frame and wakes the renderer */
+static inline void oled_frames_publish(struct oled_frames *frames, uint32_t claim)
+{
+    const uint32_t slot = claim % frames->slot_count;
+
+    __atomic_store_n(&frames->slots[slot].sequence, claim + 1u, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&frames->doorbell, 1u, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&frames->waiting, __ATOMIC_SEQ_CST) != 0) {
+        syscall(SYS_futex, &frames->doorbell, FUTEX_WAKE, 1, NULL, NULL, 0);
+    }
+}
+
+#endif /* OLED_FRAMES_H */
@@ -0,0 +1,568 @@
+#include "oledcontroller.h"
+
+#include <QVarLengthArray>
+#include <errno.h>
+
+extern "C" {
+    int i2c_write_cmd_1b(int file, uint8_t cmd);
+    int i2c_write_cmds(int file, const uint8_t cmds[], size_t len);
+    int i2c_write_data(int file, uint8_t data[], size_t len);
+    int ssd1306_init(int file, int col, int line);
+    int ssd1306_set_col_addr(int file, uint8_t start, uint8_t end);
+    int ssd1306_set_page_addr(int file, uint8_t start, uint8_t end);
+    int ssd1306_set_start_line(int file, uint8_t line);
+    int ssd1306_set_mem_addr_mode(int file, uint8_t mode);
+    int ssd1306_set_page_start(int file, uint8_t page);
+    int ssd1306_set_col_start(int file, uint8_t col);
+    int ssd1306_set_contrast(int file, uint8_t contrast);
+    int ssd1306_set_inverse(int file, bool enable);
+    int ssd1306_set_power(int file, bool enable);
+    int ssd1306_set_fade(int file, bool fade_out, bool blink, uint8_t fade_interval);
+    int ssd1306_set_mux_ratio(int file, int ratio);
+    int ssd1306_set_segment_remap(int file, bool reverse);
+    int ssd1306_set_com_scan(int file, bool reverse);
+    int ssd1306_set_display_offset(int file, uint8_t offset);
+    int ssd1306_set_clkdiv(int file, uint8_t ratio, uint8_t fosc);
+    int ssd1306_reset_com_pin(int file);
+    int ssd1306_reset_precharge(int file);
+    int ssd1306_reset_vcomh_desel(int file);
+    int ssd1306_set_display_test(int file, bool enable);
+}
+
+namespace {
+const int COMMAND_BYTES = TransferPlanner::CommandBytes;
+
+// returns the first error of a sequence of driver calls
+class Sequence
+{
+public:
+    Sequence() : m_result(0) {}
+
+    Sequence &operator<<(int res)
+    {
+        if ((m_result == 0) && (res < 0)) {
+            m_result = res;
+        }
+        return *this;
+    }
+
+    int result() const { return m_result; }
+
+private:
+    int m_result;
+};
+}
+
+OledController::~OledController()
+{
+
+}
+
+OledController *OledController::create(Type type)
+{
+    switch (type) {
+    case SSD1306:
+        return new Ssd1306Controller(true);
+    case SSD1309:
+        return new Ssd1306Controller(false);
+    case SH1106:
+        return new Sh1106Controller;
+    case SSD1322:
+        return new Ssd1322Controller;
+    }
+    return nullptr;
+}
+
+bool OledController::parseType(const QString &name, Type *type)
+{
+    const QString lower = name.toLower();
+    if (lower == "ssd1306") {
+        *type = SSD1306;
+    } else if (lower == "ssd1309") {
+        *type = SSD1309;
+    } else if (lower == "sh1106") {
+        *type = SH1106;
+    } else if (lower == "ssd1322") {
+        *type = SSD1322;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+TransferPlan::Mode OledController::defaultMode() const
+{
+    return TransferPlan::Horizontal;
+}
+
+bool OledController::canSwitchMode() const
+{
+    return false;
+}
+
+bool OledController::canScroll() const
+{
+    return false;
+}
+
+int OledController::startLines() const
+{
+    return 0;
+}
+
+int OledController::setMode(int file, TransferPlan::Mode mode)
+{
+    Q_UNUSED(file);
+    return mode == defaultMode() ? 0 : -EINVAL;
+}
+
+int OledController::setStartLine(int file, int line)
+{
+    Q_UNUSED(file);
+    return line == 0 ? 0 : -EINVAL;
+}
+
+void OledController::alignSpan(TransferSpan &span) const
+{
+    Q_UNUSED(span);
+}
+
+int OledController::setFade(int file, bool fadeOut, bool blink, int interval)
+{
+    // not every controller can fade on its own, the effect is simply not shown
+    Q_UNUSED(file);
+    Q_UNUSED(fadeOut);
+    Q_UNUSED(blink);
+    Q_UNUSED(interval);
+    return 0;
+}
+
+int OledController::wake(int file, int contrast, bool powerOn, bool fadeOut, bool blink, int interval)
+{
+    int total = 0;
+    int res = setFade(file, fadeOut, blink, interval);
+    if (res >= 0) {
+        total += res;
+        res = setContrast(file, contrast);
+    }
+    if ((res >= 0) && powerOn) {
+        total += res;
+        res = setPowered(file, true);
+    }
+    return res < 0 ? res : total + res;
+}
+
+int OledController::command(int file, const uint8_t *bytes, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        const int res = i2c_write_cmd_1b(file, bytes[i]);
+        if (res < 0) {
+            return res;
+        }
+    }
+    return count * COMMAND_BYTES;
+}
+
+int OledController::data(int file, const uint8_t *bytes, int count)
+{
+    QVarLengthArray<uint8_t, 16> buffer(count + 1);
+    buffer[0] = 0x40;
+    memcpy(buffer.data() + 1, bytes, static_cast<size_t>(count));
+    const int res = i2c_write_data(file, buffer.data(), static_cast<size_t>(buffer.size()));
+    return res < 0 ? res : buffer.size();
+}
+
+Ssd1306Controller::Ssd1306Controller(bool chargePump)
+    : m_chargePump(chargePump)
+{
+
+}
+
+bool Ssd1306Controller::supports(const QSize &size) const
+{
+    return (size.width() > 0) && (size.height() > 0)
+            && (size.width() <= Ssd1306Traits::MaxColumns) && (size.height() <= Ssd1306Traits::RamLines)
+            && ((size.width() % 8) == 0) && ((size.height() % 8) == 0);
+}
+
+int Ssd1306Controller::init(int file, const QSize &size)
+{
+    if (m_chargePump) {
+        return ssd1306_init(file, size.width(), size.height());
+    }
+
+    // ssd1306_init would enable the charge pump, which the SSD1309 does not have
+    Sequence sequence;
+    sequence << ssd1306_set_power(file, false)
+             << ssd1306_set_clkdiv(file, 1, 8)
+             << ssd1306_set_mux_ratio(file, size.height())
+             << ssd1306_set_display_offset(file, 0)
+             << ssd1306_set_start_line(file, 0)
+             << ssd1306_set_mem_addr_mode(file, TransferPlan::Horizontal)
+             << ssd1306_set_segment_remap(file, true)
+             << ssd1306_set_com_scan(file, true)
+             << ssd1306_reset_com_pin(file)
+             << ssd1306_set_contrast(file, 0x7f)
+             << ssd1306_reset_precharge(file)
+             << ssd1306_reset_vcomh_desel(file)
+             << ssd1306_set_display_test(file, false)
+             << ssd1306_set_inverse(file, false)
+             << ssd1306_set_col_addr(file, 0, static_cast<uint8_t>(size.width() - 1))
+             << ssd1306_set_page_addr(file, 0, Ssd1306Traits::RamPages - 1)
+             << ssd1306_set_power(file, true);
+    return sequence.result();
+}
+
+int Ssd1306Controller::ramUnits(const QSize &size) const
+{
+    Q_UNUSED(size);
+    return Ssd1306Traits::RamPages;
+}
+
+int Ssd1306Controller::unitBytes(const QSize &size) const
+{
+    return size.width();
+}
+
+int Ssd1306Controller::frameBytes(const QSize &size) const
+{
+    return size.width() * size.height() / 8;
+}
+
+QImage::Format Ssd1306Controller::imageFormat() const
+{
+    return QImage::Format_Mono;
+}
+
+PanelKernels Ssd1306Controller::kernels(const QSize &size) const
+{
+    return PanelKernels::select(size);
+}
+
+bool Ssd1306Controller::canSwitchMode() const
+{
+    return true;
+}
+
+bool Ssd1306Controller::canScroll() const
+{
+    return true;
+}
+
+int Ssd1306Controller::startLines() const
+{
+    return Ssd1306Traits::RamLines;
+}
+
+int Ssd1306Controller::setMode(int file, TransferPlan::Mode mode)
+{
+    const int res = ssd1306_set_mem_addr_mode(file, static_cast<uint8_t>(mode));
+    return res < 0 ? res : TransferPlanner::ModeCommandBytes;
+}
+
+int Ssd1306Controller::setStartLine(int file, int line)
+{
+    const int res = ssd1306_set_start_line(file, static_cast<uint8_t>(line));
+    return res < 0 ? res : COMMAND_BYTES;
+}
+
+int Ssd1306Controller::selectSpan(int file, TransferPlan::Mode mode, const TransferSpan &span)
+{
+    Sequence sequence;
+    if (mode == TransferPlan::Page) {
+        sequence << ssd1306_set_page_start(file, static_cast<uint8_t>(span.firstPage))
+                 << ssd1306_set_col_start(file, static_cast<uint8_t>(span.firstColumn));
+        return sequence.result() < 0 ? sequence.result() : TransferPlanner::PageCommandBytes;
+    }
+
+    sequence << ssd1306_set_col_addr(file, static_cast<uint8_t>(span.firstColumn), static_cast<uint8_t>(span.lastColumn))
+             << ssd1306_set_page_addr(file, static_cast<uint8_t>(span.firstPage), static_cast<uint8_t>(span.lastPage));
+    return sequence.result() < 0 ? sequence.result() : TransferPlanner::WindowCommandBytes;
+}
+
+int Ssd1306Controller::setContrast(int file, int contrast)
+{
+    const int res = ssd1306_set_contrast(file, static_cast<uint8_t>(qBound(0, contrast, 255)));
+    return res < 0 ? res : 2 * COMMAND_BYTES;
+}
+
+int Ssd1306Controller::setInverted(int file, bool inverted)
+{
+    const int res = ssd1306_set_inverse(file, inverted);
+    return res < 0 ? res : COMMAND_BYTES;
+}
+
+int Ssd1306Controller::setPowered(int file, bool powered)
+{
+    const int res = ssd1306_set_power(file, powered);
+    return res < 0 ? res : COMMAND_BYTES;
+}
+
+int Ssd1306Controller::setFade(int file, bool fadeOut, bool blink, int interval)
+{
+    const int res = ssd1306_set_fade(file, fadeOut, blink, static_cast<uint8_t>(qBound(8, interval, 128)));
+    return res < 0 ? res : 2 * COMMAND_BYTES;
+}
+
+int Ssd1306Controller::wake(int file, int contrast, bool powerOn, bool fadeOut, bool blink, int interval)
+{
+    // the idle fade out is replaced by whatever the scene asked for, A[5:4] as in ssd1306_set_fade
+    const int mode = blink ? 0x30 : (fadeOut ? 0x20 : 0x00);
+    return wakeCommands(file, contrast, powerOn, mode | ((qBound(8, interval, 128) / 8 - 1) & 0x0f));
+}
+
+int Ssd1306Controller::wakeCommands(int file, int contrast, bool powerOn, int fade)
+{
+    // one transfer instead of one per command byte
+    uint8_t bytes[5];
+    int count = 0;
+    if (fade >= 0) {
+        bytes[count++] = 0x23;
+        bytes[count++] = static_cast<uint8_t>(fade);
+    }
+    bytes[count++] = 0x81;
+    bytes[count++] = static_cast<uint8_t>(qBound(0, contrast, 255));
+    if (powerOn) {
+        bytes[count++] = 0xaf;
+    }
+    const int res = i2c_write_cmds(file, bytes, static_cast<size_t>(count));
+    return res < 0 ? res : count + 1;
+}
+
+Sh1106Controller::Sh1106Controller()
+    : m_columnOffset(2)
+{
+
+}
+
+bool Sh1106Controller::supports(const QSize &size) const
+{
+    return (size.width() > 0) && (size.height() > 0)
+            && (size.width() <= 132) && (size.height() <= Ssd1306Traits::RamLines)
+            && ((size.width() % 8) == 0) && ((size.height() % 8) == 0);
+}
+
+int Sh1106Controller::init(int file, const QSize &size)
+{
+    m_columnOffset = (132 - size.width()) / 2;
+
+    const uint8_t sequence[] = {
+        0xae,                                           // display off
+        0xd5, 0x80,                                     // clock divide ratio
+        0xa8, static_cast<uint8_t>(size.height() - 1),  // multiplex ratio
+        0xd3, 0x00,                                     // display offset
+        0x40,                                           // start line
+        0xad, 0x8b,                                     // DC-DC converter on
+        0xa1,                                           // segment remap
+        0xc8,                                           // reversed COM scan
+        0xda, static_cast<uint8_t>(size.height() > 32 ? 0x12 : 0x02), // COM pins
+        0x81, 0x80,                                     // contrast
+        0xd9, 0x22,                                     // precharge
+        0xdb, 0x35,                                     // VCOM deselect level
+        0xa4,                                           // display follows GDDRAM
+        0xa6,                                           // not inverted
+        0xaf                                            // display on
+    };
+    const int res = command(file, sequence, sizeof(sequence));
+    return res < 0 ? res : 0;
+}
+
+TransferPlan::Mode Sh1106Controller::defaultMode() const
+{
+    return TransferPlan::Page;
+}
+
+bool Sh1106Controller::canSwitchMode() const
+{
+    return false;
+}
+
+int Sh1106Controller::setMode(int file, TransferPlan::Mode mode)
+{
+    // there is no memory addressing mode command, only page addressing exists
+    return OledController::setMode(file, mode);
+}
+
+int Sh1106Controller::selectSpan(int file, TransferPlan::Mode mode, const TransferSpan &span)
+{
+    if (mode != TransferPlan::Page) {
+        return -EINVAL;
+    }
+
+    const int column = span.firstColumn + m_columnOffset;
+    const uint8_t sequence[] = {
+        static_cast<uint8_t>(0xb0 | (span.firstPage & 0x07)),
+        static_cast<uint8_t>(0x00 | (column & 0x0f)),
+        static_cast<uint8_t>(0x10 | ((column >> 4) & 0x0f))
+    };
+    return command(file, sequence, sizeof(sequence));
+}
+
+int Sh1106Controller::setFade(int file, bool fadeOut, bool blink, int interval)
+{
+    // no fade or blink engine
+    return OledController::setFade(file, fadeOut, blink, interval);
+}
+
+int Sh1106Controller::wake(int file, int contrast, bool powerOn, bool fadeOut, bool blink, int interval)
+{
+    // there is no fade to restore, 0x23 is not a command here
+    Q_UNUSED(fadeOut);
+    Q_UNUSED(blink);
+    Q_UNUSED(interval);
+    return wakeCommands(file, contrast, powerOn, -1);
+}
+
+Ssd1322Controller::Ssd1322Controller()
+    : m_columnOffset(0x1c)
+{
+
+}
+
+bool Ssd1322Controller::supports(const QSize &size) const
+{
+    return (size.width() > 0) && (size.width() <= Ssd1322Traits::MaxColumns) && ((size.width() % 4) == 0)
+            && (size.height() == Ssd1322Traits::RamLines);
+}
+
+int Ssd1322Controller::init(int file, const QSize &size)
+{
+    // column addresses count 4 pixel groups of the 480 pixel wide GDDRAM
+    m_columnOffset = (480 - size.width()) / 8;
+
+    struct Step {
+        uint8_t command;
+        uint8_t count;
+        uint8_t parameters[2];
+    };
+    const Step steps[] = {
+        {0xfd, 1, {0x12, 0x00}},                                 // unlock
+        {0xae, 0, {0x00, 0x00}},                                 // display off
+        {0xb3, 1, {0x91, 0x00}},                                 // clock divider
+        {0xca, 1, {static_cast<uint8_t>(size.height() - 1), 0}}, // multiplex ratio
+        {0xa2, 1, {0x00, 0x00}},                                 // display offset
+        {0xa1, 1, {0x00, 0x00}},                                 // start line
+        {0xa0, 2, {0x14, 0x11}},                                 // remap, dual COM
+        {0xb5, 1, {0x00, 0x00}},                                 // GPIO
+        {0xab, 1, {0x01, 0x00}},                                 // internal VDD
+        {0xb4, 2, {0xa0, 0xfd}},                                 // display enhancement A
+        {0xc1, 1, {0x7f, 0x00}},                                 // contrast
+        {0xc7, 1, {0x0f, 0x00}},                                 // master contrast
+        {0xb9, 0, {0x00, 0x00}},                                 // linear gray scale table
+        {0xb1, 1, {0xe2, 0x00}},                                 // phase length
+        {0xd1, 2, {0x82, 0x20}},                                 // display enhancement B
+        {0xbb, 1, {0x1f, 0x00}},                                 // precharge voltage
+        {0xb6, 1, {0x08, 0x00}},                                 // second precharge period
+        {0xbe, 1, {0x07, 0x00}},                                 // VCOMH
+        {0xa6, 0, {0x00, 0x00}},                                 // normal display
+        {0xa9, 0, {0x00, 0x00}},                                 // exit partial display
+        {0xaf, 0, {0x00, 0x00}}                                  // display on
+    };
+
+    for (const Step &step : steps) {
+        int res = command(file, &step.command, 1);
+        if ((res >= 0) && (step.count > 0)) {
+            res = data(file, step.parameters, step.count);
+        }
+        if (res < 0) {
+            return res;
+        }
+    }
+    return 0;
+}
+
+int Ssd1322Controller::ramUnits(const QSize &size) const
+{
+    return size.height();
+}
+
+int Ssd1322Controller::unitBytes(const QSize &size) const
+{
+    return size.width() / 2;
+}
+
+int Ssd1322Controller::frameBytes(const QSize &size) const
+{
+    return size.width() / 2 * size.height();
+}
+
+QImage::Format Ssd1322Controller::imageFormat() const
+{
+    return QImage::Format_RGB32;
+}
+
+PanelKernels Ssd1322Controller::kernels(const QSize &size) const
+{
+    return PanelKernels::selectGray4(size);
+}
+
+void Ssd1322Controller::alignSpan(TransferSpan &span) const
+{
+    // one column address covers 4 pixels, that is 2 bytes
+    span.firstColumn &= ~1;
+    span.lastColumn |= 1;
+}
+
+int Ssd1322Controller::selectSpan(int file, TransferPlan::Mode mode, const TransferSpan &span)
+{
+    if (mode != TransferPlan::Horizontal) {
+        return -EINVAL;
+    }
+
+    const uint8_t setColumns = 0x15;
+    const uint8_t columns[] = {
+        static_cast<uint8_t>(m_columnOffset + span.firstColumn / 2),
+        static_cast<uint8_t>(m_columnOffset + span.lastColumn / 2)
+    };
+    const uint8_t setRows = 0x75;
+    const uint8_t rows[] = {
+        static_cast<uint8_t>(span.firstPage),
+        static_cast<uint8_t>(span.lastPage)
+    };
+    const uint8_t writeRam = 0x5c;
+
+    int total = 0;
+    int res = command(file, &setColumns, 1);
+    if (res >= 0) {
+        total += res;
+        res = data(file, columns, 2);
+    }
+    if (res >= 0) {
+        total += res;
+        res = command(file, &setRows, 1);
+    }
+    if (res >= 0) {
+        total += res;
+        res = data(file, rows, 2);
+    }
+    if (res >= 0) {
+        total += res;
+        res = command(file, &writeRam, 1);
+    }
+    return res < 0 ? res : total + res;
+}
+
+int Ssd1322Controller::setContrast(int file, int contrast)
+{
+    const uint8_t setContrast = 0xc1;
+    const uint8_t value = static_cast<uint8_t>(qBound(0, contrast, 255));
+    int res = command(file, &setContrast, 1);
+    if (res < 0) {
+        return res;
+    }
+    const int total = res;
+    res = data(file, &value, 1);
+    return res < 0 ? res : total + res;
+}
+
+int Ssd1322Controller::setInverted(int file, bool inverted)
+{
+    const uint8_t mode = inverted ? 0xa7 : 0xa6;
+    return command(file, &mode, 1);
+}
+
+int Ssd1322Controller::setPowered(int file, bool powered)
+{
+    const uint8_t power = powered ? 0xaf : 0xae;
+    return command(file, &power, 1);
+}
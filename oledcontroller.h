@@ -0,0 +1,147 @@
+#ifndef OLEDCONTROLLER_H
+#define OLEDCONTROLLER_H
+
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include "panelkernels.h"
+#include "transferplanner.h"
+
+// Controller specific part of the display pipeline: initialisation, GDDRAM layout, packing
+// kernels and addressing commands. Rendering, diffing, planning and the data transfer itself
+// are shared by all controllers.
+//
+// Methods that talk to the bus return the number of bytes put on the bus or a negative error.
+class OledController
+{
+public:
+    enum Type {
+        SSD1306,
+        SSD1309,
+        SH1106,
+        SSD1322
+    };
+
+    virtual ~OledController();
+
+    static OledController *create(Type type);
+    static bool parseType(const QString &name, Type *type);
+
+    virtual bool supports(const QSize &size) const = 0;
+    virtual int init(int file, const QSize &size) = 0;
+
+    // The GDDRAM is mirrored as ramUnits() pages (1 bpp) or lines (4 bpp) of unitBytes() bytes.
+    virtual int ramUnits(const QSize &size) const = 0;
+    virtual int unitBytes(const QSize &size) const = 0;
+    virtual int frameBytes(const QSize &size) const = 0;
+    virtual QImage::Format imageFormat() const = 0;
+    virtual PanelKernels kernels(const QSize &size) const = 0;
+
+    virtual TransferPlan::Mode defaultMode() const;
+    virtual bool canSwitchMode() const;
+    virtual bool canScroll() const;
+    virtual int startLines() const;
+
+    virtual int setMode(int file, TransferPlan::Mode mode);
+    virtual int setStartLine(int file, int line);
+    virtual void alignSpan(TransferSpan &span) const;
+    virtual int selectSpan(int file, TransferPlan::Mode mode, const TransferSpan &span) = 0;
+
+    virtual int setContrast(int file, int contrast) = 0;
+    virtual int setInverted(int file, bool inverted) = 0;
+    virtual int setPowered(int file, bool powered) = 0;
+    virtual int setFade(int file, bool fadeOut, bool blink, int interval);
+    // leaves an idle state: restores the fade state and the contrast and switches the panel on
+    virtual int wake(int file, int contrast, bool powerOn, bool fadeOut, bool blink, int interval);
+
+protected:
+    static int command(int file, const uint8_t *bytes, int count);
+    static int data(int file, const uint8_t *bytes, int count);
+};
+
+class Ssd1306Controller : public OledController
+{
+public:
+    // the SSD1309 shares the command set but has no internal charge pump
+    explicit Ssd1306Controller(bool chargePump = true);
+
+    bool supports(const QSize &size) const override;
+    int init(int file, const QSize &size) override;
+
+    int ramUnits(const QSize &size) const override;
+    int unitBytes(const QSize &size) const override;
+    int frameBytes(const QSize &size) const override;
+    QImage::Format imageFormat() const override;
+    PanelKernels kernels(const QSize &size) const override;
+
+    bool canSwitchMode() const override;
+    bool canScroll() const override;
+    int startLines() const override;
+
+    int setMode(int file, TransferPlan::Mode mode) override;
+    int setStartLine(int file, int line) override;
+    int selectSpan(int file, TransferPlan::Mode mode, const TransferSpan &span) override;
+
+    int setContrast(int file, int contrast) override;
+    int setInverted(int file, bool inverted) override;
+    int setPowered(int file, bool powered) override;
+    int setFade(int file, bool fadeOut, bool blink, int interval) override;
+    int wake(int file, int contrast, bool powerOn, bool fadeOut, bool blink, int interval) override;
+
+protected:
+    // contrast, power and an optional 0x23 fade command in one transfer, fade < 0 leaves it out
+    static int wakeCommands(int file, int contrast, bool powerOn, int fade);
+
+private:
+    bool m_chargePump;
+};
+
+// 132 column GDDRAM with the panel centered in it, page addressing only
+class Sh1106Controller : public Ssd1306Controller
+{
+public:
+    Sh1106Controller();
+
+    bool supports(const QSize &size) const override;
+    int init(int file, const QSize &size) override;
+
+    TransferPlan::Mode defaultMode() const override;
+    bool canSwitchMode() const override;
+
+    int setMode(int file, TransferPlan::Mode mode) override;
+    int selectSpan(int file, TransferPlan::Mode mode, const TransferSpan &span) override;
+
+    int setFade(int file, bool fadeOut, bool blink, int interval) override;
+    int wake(int file, int contrast, bool powerOn, bool fadeOut, bool blink, int interval) override;
+
+private:
+    int m_columnOffset;
+};
+
+// 4 bpp grayscale, command parameters are sent as data bytes
+class Ssd1322Controller : public OledController
+{
+public:
+    Ssd1322Controller();
+
+    bool supports(const QSize &size) const override;
+    int init(int file, const QSize &size) override;
+
+    int ramUnits(const QSize &size) const override;
+    int unitBytes(const QSize &size) const override;
+    int frameBytes(const QSize &size) const override;
+    QImage::Format imageFormat() const override;
+    PanelKernels kernels(const QSize &size) const override;
+
+    void alignSpan(TransferSpan &span) const override;
+    int selectSpan(int file, TransferPlan::Mode mode, const TransferSpan &span) override;
+
+    int setContrast(int file, int contrast) override;
+    int setInverted(int file, bool inverted) override;
+    int setPowered(int file, bool powered) override;
+
+private:
+    int m_columnOffset;
+};
+
+#endif // OLEDCONTROLLER_H
@@ -0,0 +1,90 @@
+#include "oleddisplay.h"
+
+OledDisplay::OledDisplay(QObject *parent)
+    : QObject(parent)
+    , m_contrast(0x7f)
+    , m_inverted(false)
+    , m_powered(true)
+    , m_fade(NoFade)
+    , m_fadeInterval(8)
+{
+
+}
+
+int OledDisplay::contrast() const
+{
+    return m_contrast;
+}
+
+bool OledDisplay::isInverted() const
+{
+    return m_inverted;
+}
+
+bool OledDisplay::isPowered() const
+{
+    return m_powered;
+}
+
+OledDisplay::Fade OledDisplay::fade() const
+{
+    return m_fade;
+}
+
+int OledDisplay::fadeInterval() const
+{
+    return m_fadeInterval;
+}
+
+void OledDisplay::setContrast(int contrast)
+{
+    contrast = qBound(0, contrast, 255);
+    if (m_contrast == contrast) {
+        return;
+    }
+
+    m_contrast = contrast;
+    emit contrastChanged(m_contrast);
+}
+
+void OledDisplay::setInverted(bool inverted)
+{
+    if (m_inverted == inverted) {
+        return;
+    }
+
+    m_inverted = inverted;
+    emit invertedChanged(m_inverted);
+}
+
+void OledDisplay::setPowered(bool powered)
+{
+    if (m_powered == powered) {
+        return;
+    }
+
+    m_powered = powered;
+    emit poweredChanged(m_powered);
+}
+
+void OledDisplay::setFade(Fade fade)
+{
+    if (m_fade == fade) {
+        return;
+    }
+
+    m_fade = fade;
+    emit fadeChanged();
+}
+
+void OledDisplay::setFadeInterval(int frames)
+{
+    // the controller steps the fade every 8 to 128 frames in multiples of 8
+    frames = qBound(8, frames - frames % 8, 128);
+    if (m_fadeInterval == frames) {
+        return;
+    }
+
+    m_fadeInterval = frames;
+    emit fadeIntervalChanged();
+}
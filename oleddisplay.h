@@ -0,0 +1,53 @@
+#ifndef OLEDDISPLAY_H
+#define OLEDDISPLAY_H
+
+#include <QObject>
+
+class OledDisplay : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(int contrast READ contrast WRITE setContrast NOTIFY contrastChanged)
+    Q_PROPERTY(bool inverted READ isInverted WRITE setInverted NOTIFY invertedChanged)
+    Q_PROPERTY(bool powered READ isPowered WRITE setPowered NOTIFY poweredChanged)
+    Q_PROPERTY(Fade fade READ fade WRITE setFade NOTIFY fadeChanged)
+    Q_PROPERTY(int fadeInterval READ fadeInterval WRITE setFadeInterval NOTIFY fadeIntervalChanged)
+
+public:
+    enum Fade {
+        NoFade,
+        FadeOut,
+        Blink
+    };
+    Q_ENUMS(Fade)
+
+    explicit OledDisplay(QObject *parent = 0);
+
+    int contrast() const;
+    bool isInverted() const;
+    bool isPowered() const;
+    Fade fade() const;
+    int fadeInterval() const;
+
+public slots:
+    void setContrast(int contrast);
+    void setInverted(bool inverted);
+    void setPowered(bool powered);
+    void setFade(Fade fade);
+    void setFadeInterval(int frames);
+
+signals:
+    void contrastChanged(int contrast);
+    void invertedChanged(bool inverted);
+    void poweredChanged(bool powered);
+    void fadeChanged();
+    void fadeIntervalChanged();
+
+private:
+    int m_contrast;
+    bool m_inverted;
+    bool m_powered;
+    Fade m_fade;
+    int m_fadeInterval;
+};
+
+#endif // OLEDDISPLAY_H
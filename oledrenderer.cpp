@@ -1,25 +1,142 @@
 #include "oledrenderer.h"
 
+#include <QCoreApplication>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QtMath>
+#include <QQmlContext>
+#include <QSemaphore>
+#include <QStringList>
 #include <QSurfaceFormat>
+#include <private/qquickitem_p.h>
+#include <private/qquickwindow_p.h>
+#include "frametracer.h"
+
+namespace {
+
+// The CPU path never syncs, so the items stay on the dirty list of the window and a further
+// change of the same kind no longer announces itself with sceneChanged. Taking them off the list
+// makes the next change signal again, the dirty attributes stay for a later sync.
+void detachDirtyItems(QQuickWindow *window)
+{
+    QQuickWindowPrivate *windowPrivate = QQuickWindowPrivate::get(window);
+    while (QQuickItem *item = windowPrivate->dirtyItemList) {
+        QQuickItemPrivate::get(item)->removeFromDirtyList();
+    }
+}
+
+void attachDirtyItems(QQuickItem *item)
+{
+    QQuickItemPrivate *d = QQuickItemPrivate::get(item);
+    if (d->dirtyAttributes != 0) {
+        d->addToDirtyList();
+    }
+    const QList<QQuickItem *> children = item->childItems();
+    for (QQuickItem *child : children) {
+        attachDirtyItems(child);
+    }
+}
+
+}
 
 OledRenderer::OledRenderer(QObject *parent)
     : QObject(parent)
     , m_context(nullptr)
     , m_offscreenSurface(nullptr)
-    , m_renderControl(nullptr)
-    , m_quickWindow(nullptr)
     , m_qmlEngine(nullptr)
-    , m_qmlComponent(nullptr)
-    , m_rootItem(nullptr)
-    , m_fbo(nullptr)
+    , m_lowMemory(false)
+    , m_monoActive(false)
+    , m_renderThread(nullptr)
+    , m_renderWorker(nullptr)
+    , m_synced(false)
+    , m_framesDropped(0)
+    , m_framesRendered(0)
+    , m_framesSkipped(0)
+    , m_pendingInput(0)
+    , m_frameInput(0)
+    , m_dpr(1.0)
     , m_animationDriver(nullptr)
     , m_status(NotRunning)
+    , m_pauseReasons(0)
+    , m_fps(24)
     , m_renderTimer(nullptr)
+    , m_gcInterval(0)
+    , m_lastGcNsecs(0)
+{
+
+}
+
+OledRenderer::~OledRenderer()
 {
+    for (Layer *layer : m_layers) {
+        destroyLayer(layer);
+    }
+    m_layers.clear();
+    delete m_qmlEngine;
+
+    if (m_context != nullptr) {
+        runOnRenderThread([this]() {
+            m_context->doneCurrent();
+            delete m_context;
+        });
+    }
+    if (m_renderThread != nullptr) {
+        m_renderThread->quit();
+        m_renderThread->wait();
+        delete m_renderWorker;
+        delete m_renderThread;
+    }
+
+    delete m_offscreenSurface;
+    delete m_animationDriver;
+    delete m_renderTimer;
+}
+
+void OledRenderer::setRenderThreadEnabled(bool enabled)
+{
+    if (!enabled || (m_renderThread != nullptr) || (m_status != NotRunning)) {
+        return;
+    }
+
+    m_renderThread = new QThread;
+    m_renderThread->setObjectName("render");
+    m_renderWorker = new QObject;
+    m_renderWorker->moveToThread(m_renderThread);
+    m_renderThread->start();
+}
+
+void OledRenderer::setLowMemory(bool lowMemory)
+{
+    if (m_context == nullptr) {
+        m_lowMemory = lowMemory;
+    }
+}
+
+void OledRenderer::initialize()
+{
+    if (m_context != nullptr) {
+        return;
+    }
+
     QSurfaceFormat format;
-    // Qt Quick may need a depth and stencil buffer. Always make sure these are available.
-    format.setDepthBufferSize(16);
-    format.setStencilBufferSize(8);
+    if (m_lowMemory) {
+        // Without a depth buffer the scene graph draws back to front, which costs nothing on a
+        // panel this small. The atlas and glyph caches Qt Quick sizes for desktop windows are
+        // several times the panel, text is rendered with native glyphs instead of distance fields.
+        format.setDepthBufferSize(0);
+        format.setStencilBufferSize(0);
+        if (!qEnvironmentVariableIsSet("QSG_ATLAS_WIDTH") && !qEnvironmentVariableIsSet("QSG_ATLAS_HEIGHT")) {
+            qputenv("QSG_ATLAS_WIDTH", "256");
+            qputenv("QSG_ATLAS_HEIGHT", "256");
+        }
+        if (!qEnvironmentVariableIsSet("QML_DISABLE_DISTANCEFIELD")) {
+            qputenv("QML_DISABLE_DISTANCEFIELD", "1");
+        }
+    } else {
+        // Qt Quick may need a depth and stencil buffer. Always make sure these are available.
+        format.setDepthBufferSize(16);
+        format.setStencilBufferSize(8);
+    }
     format.setSamples(1);
 
     m_context = new QOpenGLContext;
@@ -30,57 +147,133 @@ OledRenderer::OledRenderer(QObject *parent)
     m_offscreenSurface->setFormat(m_context->format());
     m_offscreenSurface->create();
 
-    m_renderControl = new QQuickRenderControl(this);
-    m_quickWindow = new QQuickWindow(m_renderControl);
+    if (m_renderThread == nullptr) {
+        m_context->makeCurrent(m_offscreenSurface);
+    } else {
+        // the context is only used by the render thread from now on
+        m_context->moveToThread(m_renderThread);
+    }
+}
 
-    m_qmlEngine = new QQmlEngine;
-    if (!m_qmlEngine->incubationController())
-        m_qmlEngine->setIncubationController(m_quickWindow->incubationController());
+QQmlEngine *OledRenderer::engine()
+{
+    // created on first use, after the options that shape it are set
+    if (m_qmlEngine == nullptr) {
+        m_qmlEngine = new QQmlEngine;
+    }
+    return m_qmlEngine;
+}
 
-    m_context->makeCurrent(m_offscreenSurface);
-    m_renderControl->initialize(m_context);
+QThread *OledRenderer::renderThread() const
+{
+    return m_renderThread;
 }
 
-OledRenderer::~OledRenderer()
+quint64 OledRenderer::framesDropped() const
 {
-    m_context->makeCurrent(m_offscreenSurface);
-    delete m_renderControl;
-    delete m_qmlComponent;
-    delete m_quickWindow;
-    delete m_qmlEngine;
-    delete m_fbo;
+    return m_framesDropped.load();
+}
 
-    m_context->doneCurrent();
+quint64 OledRenderer::framesRendered() const
+{
+    return m_framesRendered.load();
+}
 
-    delete m_offscreenSurface;
-    delete m_context;
-    delete m_animationDriver;
-    delete m_renderTimer;
+quint64 OledRenderer::framesSkipped() const
+{
+    return m_framesSkipped.load();
 }
 
-void OledRenderer::loadQmlFile(const QString &qmlFile, const QSize &size, qreal devicePixelRatio, int fps)
+void OledRenderer::runOnRenderThread(const std::function<void()> &function)
 {
-    if (m_status != NotRunning) {
+    if (m_renderThread == nullptr) {
+        function();
         return;
     }
 
+    QSemaphore done;
+    QTimer::singleShot(0, m_renderWorker, [&function, &done]() {
+        function();
+        done.release();
+    });
+    done.acquire();
+}
+
+bool OledRenderer::loadQmlFile(const QString &qmlFile, const QSize &size, qreal devicePixelRatio, int fps)
+{
+    if ((m_status != NotRunning) || !m_layers.isEmpty()) {
+        return false;
+    }
+
     m_size = size;
     m_dpr = devicePixelRatio;
     m_fps = fps;
 
-    if (!loadQml(qmlFile, size)) {
-        return;
+    Layer *layer = createLayer(QRect(QPoint(0, 0), size), 0);
+    if (!loadQml(layer, qmlFile)) {
+        destroyLayer(layer);
+        return false;
     }
+    m_layers.prepend(layer);
+    return true;
+}
 
-    start();
+bool OledRenderer::addLayer(const QString &qmlFile, const QRect &region, int z)
+{
+    Layer *layer = createLayer(region, z);
+    // overlays only cover the panel where they draw something
+    layer->quickWindow->setColor(Qt::transparent);
+    if (!loadQml(layer, qmlFile)) {
+        destroyLayer(layer);
+        return false;
+    }
+
+    // keep the order stable for layers with the same z
+    int index = m_layers.size();
+    while ((index > 0) && (m_layers.at(index - 1)->z > z)) {
+        --index;
+    }
+    m_layers.insert(index, layer);
+    return true;
+}
+
+bool OledRenderer::parseLayer(const QString &spec, const QSize &panelSize, QString *qmlFile, QRect *region, int *z)
+{
+    const int at = spec.lastIndexOf('@');
+    *qmlFile = spec.left(at);
+    *region = QRect(QPoint(0, 0), panelSize);
+    if (at < 0) {
+        return !qmlFile->isEmpty();
+    }
+
+    const QStringList values = spec.mid(at + 1).split(',');
+    if ((values.size() != 4) && (values.size() != 5)) {
+        return false;
+    }
+    int numbers[5];
+    for (int i = 0; i < values.size(); ++i) {
+        bool ok = false;
+        numbers[i] = values.at(i).toInt(&ok);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    *region = QRect(numbers[0], numbers[1], numbers[2], numbers[3]);
+    if (values.size() == 5) {
+        *z = numbers[4];
+    }
+    return !qmlFile->isEmpty() && !region->isEmpty() && QRect(QPoint(0, 0), panelSize).contains(*region);
 }
 
 void OledRenderer::start()
 {
+    if ((m_status != NotRunning) || m_layers.isEmpty()) {
+        return;
+    }
     m_status = Running;
-    createFbo();
 
-    if (!m_context->makeCurrent(m_offscreenSurface)) {
+    if ((m_renderThread == nullptr) && !m_context->makeCurrent(m_offscreenSurface)) {
         return;
     }
 
@@ -92,6 +285,8 @@ void OledRenderer::start()
     // Start the renderer
     m_renderTimer = new QTimer;
     m_renderTimer->setInterval(renderInterval);
+    // the default coarse timer may fire 5 % late, which shows up as frame jitter
+    m_renderTimer->setTimerType(Qt::PreciseTimer);
     connect(m_renderTimer, &QTimer::timeout, this, &OledRenderer::renderNext);
     m_renderTimer->start();
     renderNext();
@@ -107,74 +302,385 @@ void OledRenderer::cleanup()
         delete m_renderTimer;
         m_renderTimer = nullptr;
     }
-
-    destroyFbo();
 }
 
-void OledRenderer::createFbo()
+OledRenderer::Layer *OledRenderer::createLayer(const QRect &region, int z)
 {
-    m_fbo = new QOpenGLFramebufferObject(m_size * m_dpr, QOpenGLFramebufferObject::CombinedDepthStencil);
-    m_quickWindow->setRenderTarget(m_fbo);
+    initialize();
+
+    Layer *layer = new Layer;
+    layer->renderControl = new QQuickRenderControl(this);
+    layer->quickWindow = new QQuickWindow(layer->renderControl);
+    layer->qmlComponent = nullptr;
+    layer->rootItem = nullptr;
+    layer->fbo = nullptr;
+    layer->region = region;
+    layer->z = z;
+    layer->dirty.store(1);
+    layer->syncing = false;
+
+    if (!engine()->incubationController())
+        engine()->setIncubationController(layer->quickWindow->incubationController());
+
+    // all layers render with the same context, one after the other
+    if (m_renderThread != nullptr) {
+        layer->renderControl->prepareThread(m_renderThread);
+    }
+    runOnRenderThread([this, layer]() {
+        m_context->makeCurrent(m_offscreenSurface);
+        layer->renderControl->initialize(m_context);
+    });
+    createFbo(layer, !m_lowMemory);
+    layer->quickWindow->setGeometry(0, 0, region.width(), region.height());
+
+    // a layer only has to be rendered again after its scene changed
+    connect(layer->renderControl, &QQuickRenderControl::sceneChanged, [this, layer]() {
+        layer->dirty.store(1);
+        emit sceneChanged();
+    });
+    connect(layer->renderControl, &QQuickRenderControl::renderRequested, [this, layer]() {
+        layer->dirty.store(1);
+        emit sceneChanged();
+    });
+
+    return layer;
 }
 
-void OledRenderer::destroyFbo()
+void OledRenderer::destroyLayer(Layer *layer)
 {
-    delete m_fbo;
-    m_fbo = nullptr;
+    // scene graph resources belong to the thread that renders them
+    runOnRenderThread([this, layer]() {
+        m_context->makeCurrent(m_offscreenSurface);
+        layer->renderControl->invalidate();
+        delete layer->fbo;
+    });
+    delete layer->renderControl;
+    delete layer->qmlComponent;
+    delete layer->quickWindow;
+    delete layer;
 }
 
-bool OledRenderer::loadQml(const QString &qmlFile, const QSize &size)
+bool OledRenderer::loadQml(Layer *layer, const QString &qmlFile)
 {
-    if (m_qmlComponent != nullptr) {
-        delete m_qmlComponent;
-    }
-    m_qmlComponent = new QQmlComponent(m_qmlEngine, QUrl(qmlFile), QQmlComponent::PreferSynchronous);
+    layer->qmlComponent = new QQmlComponent(engine(), QUrl(qmlFile), QQmlComponent::PreferSynchronous);
 
-    if (m_qmlComponent->isError()) {
-        const QList<QQmlError> errorList = m_qmlComponent->errors();
+    if (layer->qmlComponent->isError()) {
+        const QList<QQmlError> errorList = layer->qmlComponent->errors();
         for (const QQmlError &error : errorList)
             qWarning() << error.url() << error.line() << error;
         return false;
     }
 
-    QObject *rootObject = m_qmlComponent->create();
-    if (m_qmlComponent->isError()) {
-        const QList<QQmlError> errorList = m_qmlComponent->errors();
+    QObject *rootObject = layer->qmlComponent->create();
+    if (layer->qmlComponent->isError()) {
+        const QList<QQmlError> errorList = layer->qmlComponent->errors();
         for (const QQmlError &error : errorList)
             qWarning() << error.url() << error.line() << error;
         return false;
     }
 
-    m_rootItem = qobject_cast<QQuickItem *>(rootObject);
-    if (!m_rootItem) {
+    layer->rootItem = qobject_cast<QQuickItem *>(rootObject);
+    if (!layer->rootItem) {
         qWarning("run: Not a QQuickItem");
         delete rootObject;
         return false;
     }
 
     // The root item is ready. Associate it with the window.
-    m_rootItem->setParentItem(m_quickWindow->contentItem());
-
-    m_rootItem->setWidth(size.width());
-    m_rootItem->setHeight(size.height());
+    layer->rootItem->setParentItem(layer->quickWindow->contentItem());
 
-    m_quickWindow->setGeometry(0, 0, size.width(), size.height());
+    layer->rootItem->setWidth(layer->region.width());
+    layer->rootItem->setHeight(layer->region.height());
 
+    if (m_lowMemory) {
+        if (needsStencil(layer->rootItem)) {
+            createFbo(layer, true);
+        }
+        engine()->trimComponentCache();
+    }
     return true;
 }
 
+void OledRenderer::createFbo(Layer *layer, bool depthStencil)
+{
+    runOnRenderThread([this, layer, depthStencil]() {
+        m_context->makeCurrent(m_offscreenSurface);
+        delete layer->fbo;
+        layer->fbo = new QOpenGLFramebufferObject(layer->region.size() * m_dpr,
+                                                  depthStencil ? QOpenGLFramebufferObject::CombinedDepthStencil
+                                                               : QOpenGLFramebufferObject::NoAttachment);
+        layer->quickWindow->setRenderTarget(layer->fbo);
+    });
+}
+
+bool OledRenderer::needsStencil(QQuickItem *item)
+{
+    // a clip that is not an axis aligned rectangle on the panel is drawn into the stencil buffer
+    if (item->clip() && (QQuickItemPrivate::get(item)->itemToWindowTransform().type() > QTransform::TxScale)) {
+        return true;
+    }
+    const QList<QQuickItem *> children = item->childItems();
+    for (QQuickItem *child : children) {
+        if (needsStencil(child)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void OledRenderer::renderNext()
 {
-    // Polish, synchronize and render the next frame (into our fbo).
-    m_renderControl->polishItems();
-    m_renderControl->sync();
-    m_renderControl->render();
+    TraceSpan span("frame");
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+    if (m_sinceFrame.isValid()) {
+        m_statistics.addSample(FrameStatistics::FrameInterval, m_sinceFrame.nsecsElapsed());
+    }
+    m_sinceFrame.start();
+
+    if (m_pauseReasons != 0) {
+        // Animations and timers keep advancing so the scene is where it would have been when
+        // rendering resumes.
+        m_framesSkipped.fetchAndAddRelaxed(1);
+        emit frameSkipped();
+        m_animationDriver->advance();
+        m_statistics.addSample(FrameStatistics::FrameTime, frameTimer.nsecsElapsed());
+        return;
+    }
 
+    if (m_renderBusy.loadAcquire() != 0) {
+        // the render thread is still busy with the previous frame, the scene moves on without it
+        m_framesDropped.fetchAndAddRelaxed(1);
+    } else {
+        // key events delivered until now show in this frame
+        m_frameInput = m_pendingInput;
+        m_pendingInput = 0;
+        if (!renderMono()) {
+            polishLayers();
+            if (m_renderThread == nullptr) {
+                syncLayers();
+                renderLayers();
+            } else {
+                // The render thread syncs while this thread waits, as the scene graph reads the
+                // items then. Rendering and readback overlap with the next bindings and handlers.
+                m_renderBusy.storeRelease(1);
+                QMutexLocker locker(&m_syncMutex);
+                m_synced = false;
+                QTimer::singleShot(0, m_renderWorker, [this]() {
+                    m_context->makeCurrent(m_offscreenSurface);
+                    {
+                        QMutexLocker locker(&m_syncMutex);
+                        syncLayers();
+                        m_synced = true;
+                        m_syncDone.wakeOne();
+                    }
+                    renderLayers();
+                    m_renderBusy.storeRelease(0);
+                });
+                while (!m_synced) {
+                    m_syncDone.wait(&m_syncMutex);
+                }
+            }
+        }
+    }
+
+    m_animationDriver->advance();
+
+    const qint64 frameNsecs = frameTimer.nsecsElapsed();
+    m_statistics.addSample(FrameStatistics::FrameTime, frameNsecs);
+    collectGarbageIfIdle(frameNsecs);
+}
+
+void OledRenderer::polishLayers()
+{
+    // The damaged area has to be taken between polish and sync, sync clears the dirty state of
+    // the items.
+    for (Layer *layer : m_layers) {
+        layer->syncing = layer->dirty.fetchAndStoreOrdered(0) != 0;
+        if (layer->syncing) {
+            TraceSpan span("polishItems", layer->z);
+            layer->renderControl->polishItems();
+            layer->change = layer->damage.collect(layer->quickWindow->contentItem(), layer->region.size());
+        }
+    }
+}
+
+void OledRenderer::syncLayers()
+{
+    for (Layer *layer : m_layers) {
+        if (layer->syncing) {
+            TraceSpan span("sync", layer->z);
+            layer->renderControl->sync();
+        }
+    }
+}
+
+void OledRenderer::renderLayers()
+{
+    // render the layers that changed into their fbo
+    QElapsedTimer renderTimer;
+    renderTimer.start();
+    for (Layer *layer : m_layers) {
+        if (layer->syncing) {
+            TraceSpan span("render", layer->z);
+            layer->renderControl->render();
+        }
+    }
     m_context->functions()->glFlush();
+    m_statistics.addSample(FrameStatistics::Render, renderTimer.nsecsElapsed());
+
+    // only the lines that changed are read back
+    renderTimer.restart();
+    QRect damage;
+    for (Layer *layer : m_layers) {
+        if (layer->syncing && !layer->change.isEmpty()) {
+            TraceSpan span("readback", layer->change.height());
+            readBack(layer, layer->change);
+            damage |= layer->change.translated(layer->region.topLeft());
+        }
+        layer->syncing = false;
+    }
+    if (!damage.isEmpty()) {
+        m_statistics.addSample(FrameStatistics::Readback, renderTimer.nsecsElapsed());
+    }
 
-    emit imageRendered(m_fbo->toImage());
+    // without damage the previous frame is sent again, which the driver skips
+    compose(damage);
+    emitFrame((m_layers.size() == 1) ? m_layers.first()->image : m_composite, damage);
+}
 
-    m_animationDriver->advance();
+bool OledRenderer::renderMono()
+{
+    // A scene made of Mono* items only is drawn into 1 bpp lines on the CPU, without sync,
+    // render or readback. Anything else in the scene falls back to the scene graph.
+    Layer *layer = m_layers.first();
+    if ((m_layers.size() == 1) && (m_dpr == 1.0)) {
+        if (layer->dirty.load() == 0) {
+            if (m_monoActive) {
+                emitFrame(m_monoScene.image(), QRect());
+            }
+            return m_monoActive;
+        }
+
+        TraceSpan span("mono render");
+        QElapsedTimer timer;
+        timer.start();
+        layer->renderControl->polishItems();
+        if (!m_monoActive) {
+            // the first frame on the CPU path is damaged completely
+            m_monoScene.reset();
+        }
+        if (m_monoScene.render(layer->quickWindow->contentItem(), m_size)) {
+            m_monoActive = true;
+            layer->dirty.store(0);
+            detachDirtyItems(layer->quickWindow);
+            m_statistics.addSample(FrameStatistics::Render, timer.nsecsElapsed());
+            emitFrame(m_monoScene.image(), m_monoScene.damage());
+            return true;
+        }
+    }
+
+    if (m_monoActive) {
+        // the layer image is stale, the scene graph has to provide a complete frame and has to
+        // sync everything that changed while the CPU path was drawing
+        m_monoActive = false;
+        attachDirtyItems(layer->quickWindow->contentItem());
+        layer->dirty.store(1);
+        layer->damage.reset();
+    }
+    return false;
+}
+
+void OledRenderer::readBack(Layer *layer, const QRect &rect)
+{
+    const QSize size = layer->region.size() * m_dpr;
+    if (layer->image.size() != size) {
+        layer->image = QImage(size, QImage::Format_ARGB32_Premultiplied);
+        layer->image.fill(Qt::transparent);
+    }
+
+    // whole lines are read as GLES 2 cannot skip pixels within a line, the fbo is bottom up
+    const int top = qFloor(rect.top() * m_dpr);
+    const int lines = qMin(size.height(), qCeil((rect.bottom() + 1) * m_dpr)) - top;
+    const int width = size.width();
+
+    // read straight into the lines of the layer image, which are then flipped and swizzled in place
+    layer->fbo->bind();
+    m_context->functions()->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    m_context->functions()->glReadPixels(0, size.height() - top - lines, width, lines, GL_RGBA, GL_UNSIGNED_BYTE,
+                                         layer->image.scanLine(top));
+    layer->fbo->release();
+
+    for (int y = 0; y < (lines + 1) / 2; ++y) {
+        uchar *upper = layer->image.scanLine(top + y);
+        uchar *lower = layer->image.scanLine(top + lines - 1 - y);
+        for (int x = 0; x < width * 4; x += 4) {
+            const QRgb fromLower = qRgba(lower[x], lower[x + 1], lower[x + 2], lower[x + 3]);
+            const QRgb fromUpper = qRgba(upper[x], upper[x + 1], upper[x + 2], upper[x + 3]);
+            *reinterpret_cast<QRgb *>(upper + x) = fromLower;
+            *reinterpret_cast<QRgb *>(lower + x) = fromUpper;
+        }
+    }
+}
+
+void OledRenderer::compose(const QRect &damage)
+{
+    // a single layer covering the panel is shown as it is
+    if (damage.isEmpty() || (m_layers.size() == 1)) {
+        return;
+    }
+
+    // a new composite has to be drawn completely
+    QRect area = damage;
+    if ((m_composite.size() != m_size * m_dpr) || (m_composite.format() != QImage::Format_RGB32)) {
+        m_composite = QImage(m_size * m_dpr, QImage::Format_RGB32);
+        area = QRect(QPoint(0, 0), m_size);
+    }
+
+    QPainter painter(&m_composite);
+    const QRect target(area.topLeft() * m_dpr, area.size() * m_dpr);
+    painter.setClipRect(target);
+    painter.fillRect(target, Qt::white);
+    for (Layer *layer : m_layers) {
+        if (layer->region.intersects(area)) {
+            painter.drawImage(layer->region.topLeft() * m_dpr, layer->image);
+        }
+    }
+}
+
+void OledRenderer::emitFrame(const QImage &image, const QRect &damage)
+{
+    if (m_frameInput != 0) {
+        emit inputRendered(m_frameInput);
+        m_frameInput = 0;
+    }
+    m_framesRendered.fetchAndAddRelaxed(1);
+    emit imageRendered(image, damage);
+}
+
+void OledRenderer::collectGarbageIfIdle(qint64 frameNsecs)
+{
+    if ((m_gcInterval <= 0) || (m_sinceGc.isValid() && (m_sinceGc.elapsed() < m_gcInterval))) {
+        return;
+    }
+
+    // Only collect when the remaining frame budget can absorb the pause. Until the first
+    // collection has been measured, wait for a frame that left at least half of its budget.
+    const qint64 budgetNsecs = 1000000000LL / m_fps;
+    const qint64 slackNsecs = budgetNsecs - frameNsecs;
+    const qint64 expectedNsecs = (m_lastGcNsecs > 0) ? (m_lastGcNsecs * 3 / 2) : (budgetNsecs / 2);
+    if (slackNsecs < expectedNsecs) {
+        return;
+    }
+
+    TraceSpan span("gc");
+    QElapsedTimer gcTimer;
+    gcTimer.start();
+    m_qmlEngine->collectGarbage();
+    m_lastGcNsecs = gcTimer.nsecsElapsed();
+    m_statistics.addSample(FrameStatistics::GarbageCollection, m_lastGcNsecs);
+
+    m_sinceGc.start();
 }
 
 bool OledRenderer::isRunning()
@@ -184,5 +690,122 @@ bool OledRenderer::isRunning()
 
 QQuickItem *OledRenderer::rootItem()
 {
-    return m_rootItem;
+    return m_layers.isEmpty() ? nullptr : m_layers.first()->rootItem;
+}
+
+void OledRenderer::setContextProperty(const QString &name, QObject *object)
+{
+    engine()->rootContext()->setContextProperty(name, object);
+}
+
+void OledRenderer::addImageProvider(const QString &id, QQmlImageProviderBase *provider)
+{
+    engine()->addImageProvider(id, provider);
+}
+
+void OledRenderer::setIdleGarbageCollection(int intervalMs)
+{
+    m_gcInterval = intervalMs;
+}
+
+QString OledRenderer::memorySummary()
+{
+    // the fbos and frame buffers are replaced on the render thread, they are measured there
+    qint64 fboBytes = 0;
+    qint64 bufferBytes = 0;
+    runOnRenderThread([this, &fboBytes, &bufferBytes]() {
+        bufferBytes += m_composite.sizeInBytes();
+        for (Layer *layer : m_layers) {
+            const QSize size = layer->region.size() * m_dpr;
+            const qint64 pixels = size.width() * size.height();
+            fboBytes += pixels * 4;
+            if (layer->fbo->attachment() == QOpenGLFramebufferObject::CombinedDepthStencil) {
+                fboBytes += pixels * 4;
+            }
+            bufferBytes += layer->image.sizeInBytes();
+        }
+    });
+
+    // the items and the CPU path belong to this thread
+    qint64 imageBytes = 0;
+    bufferBytes += m_monoScene.sizeInBytes();
+    for (Layer *layer : m_layers) {
+        imageBytes += textureBytes(layer->quickWindow->contentItem());
+    }
+    return QString("renderer memory: fbo=%1 KiB images=%2 KiB buffers=%3 KiB")
+            .arg(fboBytes / 1024).arg(imageBytes / 1024).arg(bufferBytes / 1024);
+}
+
+qint64 OledRenderer::textureBytes(QQuickItem *item)
+{
+    // decoded images are uploaded at their source size, small ones share the atlas
+    qint64 bytes = 0;
+    if (item->inherits("QQuickImageBase")) {
+        const QSize size = item->property("sourceSize").toSize();
+        bytes += size.width() * size.height() * 4;
+    }
+    const QList<QQuickItem *> children = item->childItems();
+    for (QQuickItem *child : children) {
+        bytes += textureBytes(child);
+    }
+    return bytes;
+}
+
+const FrameStatistics &OledRenderer::statistics() const
+{
+    return m_statistics;
+}
+
+void OledRenderer::setRenderingPaused(bool paused, PauseReason reason)
+{
+    if (paused) {
+        m_pauseReasons |= reason;
+    } else {
+        m_pauseReasons &= ~reason;
+    }
+}
+
+bool OledRenderer::isRenderingPaused() const
+{
+    return m_pauseReasons != 0;
+}
+
+void OledRenderer::setFps(int fps)
+{
+    if (fps <= 0) {
+        return;
+    }
+    m_fps = fps;
+    if (m_renderTimer != nullptr) {
+        const int renderInterval = 1000 / fps;
+        m_animationDriver->setStep(renderInterval);
+        m_renderTimer->setInterval(renderInterval);
+    }
+}
+
+int OledRenderer::fps() const
+{
+    return m_fps;
+}
+
+void OledRenderer::sendKey(int key, bool pressed, qint64 timestampNs)
+{
+    if (m_layers.isEmpty()) {
+        return;
+    }
+
+    QQuickWindow *window = m_layers.first()->quickWindow;
+    if (window->activeFocusItem() == nullptr) {
+        // the offscreen window never gets focus from a window system, items with focus: true
+        // only receive keys once it has
+        QFocusEvent focus(QEvent::FocusIn, Qt::OtherFocusReason);
+        QCoreApplication::sendEvent(window, &focus);
+    }
+    QKeyEvent event(pressed ? QEvent::KeyPress : QEvent::KeyRelease, key, Qt::NoModifier);
+    event.setTimestamp(static_cast<ulong>(timestampNs / 1000000));
+    QCoreApplication::sendEvent(window, &event);
+
+    if (m_pendingInput == 0) {
+        m_pendingInput = timestampNs;
+    }
 }
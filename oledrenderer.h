@@ -1,7 +1,13 @@
 #ifndef OLEDRENDERER_H
 #define OLEDRENDERER_H
 
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
 #include <QFutureWatcher>
+#include <QImage>
+#include <QList>
+#include <QMutex>
 #include <QObject>
 #include <QOffscreenSurface>
 #include <QOpenGLContext>
@@ -12,8 +18,16 @@
 #include <QQuickRenderControl>
 #include <QQuickWindow>
 #include <QOpenGLFunctions>
+#include <QRect>
+#include <QThread>
 #include <QTimer>
+#include <QVector>
+#include <QWaitCondition>
+#include <functional>
 #include "animationdriver.h"
+#include "damagetracker.h"
+#include "framestatistics.h"
+#include "monoitems.h"
 
 class OledRenderer : public QObject
 {
@@ -24,45 +38,153 @@ public:
         Running
     };
 
+    // who paused rendering, it runs again once every reason is gone
+    enum PauseReason {
+        CachePause = 0x1,  // the loop cache replays recorded frames
+        IdlePause = 0x2,   // the panel is dimmed or asleep
+        ControlPause = 0x4 // paused through the control socket
+    };
+
     explicit OledRenderer(QObject *parent = 0);
 
     ~OledRenderer();
 
-    void loadQmlFile(const QString &qmlFile, const QSize &size, qreal devicePixelRatio = 1.0, int fps = 24);
+    // loads the main scene, nothing is rendered before start()
+    bool loadQmlFile(const QString &qmlFile, const QSize &size, qreal devicePixelRatio = 1.0, int fps = 24);
+
+    // Loads another QML file into the region of the panel, layers with a higher z are drawn on
+    // top. Every layer has its own scene graph and is only rendered again when it changed.
+    bool addLayer(const QString &qmlFile, const QRect &region, int z);
+    // parses "file.qml" or "file.qml@x,y,width,height[,z]", a missing region covers the panel
+    static bool parseLayer(const QString &spec, const QSize &panelSize, QString *qmlFile, QRect *region, int *z);
+    // renders the first frame with every layer loaded so far and starts the frame timer
+    void start();
+
+    // Syncs, renders and reads back on a thread of its own, polishing and the QML bindings stay
+    // on the calling thread. Has to be called before loadQmlFile(), imageRendered() is emitted
+    // from the render thread then.
+    void setRenderThreadEnabled(bool enabled);
+    QThread *renderThread() const;
+    // frames skipped because the render thread was still busy
+    quint64 framesDropped() const;
+    // frames handed to imageRendered() and frames not rendered while paused, may be read from
+    // any thread
+    quint64 framesRendered() const;
+    quint64 framesSkipped() const;
+
+    // Requests no depth and stencil buffer unless a scene clips rotated items when it is loaded,
+    // trims the component cache and keeps the texture atlas and glyph caches of the scene graph
+    // small. Has to be called before loadQmlFile().
+    void setLowMemory(bool lowMemory);
+    // fbo, image texture and CPU buffer memory of the scenes
+    QString memorySummary();
+    // runs the function on the render thread and waits for it, or right away without one
+    void runOnRenderThread(const std::function<void()> &function);
 
     bool isRunning();
 
     QQuickItem * rootItem();
 
+    void setContextProperty(const QString &name, QObject *object);
+    // the engine takes ownership of the provider
+    void addImageProvider(const QString &id, QQmlImageProviderBase *provider);
+    void setIdleGarbageCollection(int intervalMs);
+    const FrameStatistics &statistics() const;
+
+    // keeps animations running but skips the scene graph render and readback
+    void setRenderingPaused(bool paused, PauseReason reason);
+    bool isRenderingPaused() const;
+    // changes the frame rate of a running renderer, animations keep their speed
+    void setFps(int fps);
+    int fps() const;
+
+public slots:
+    // delivers a key event to the main scene, timestampNs is the CLOCK_MONOTONIC time of the input
+    void sendKey(int key, bool pressed, qint64 timestampNs);
+
 signals:
-    void imageRendered(const QImage &image);
+    // damage is the part of the panel that changed since the previous image, it is empty when
+    // the previous image is sent again
+    void imageRendered(const QImage &image, const QRect &damage);
+    // emitted from the same thread just before imageRendered() for the first frame rendered
+    // after sendKey(), with the timestamp of the earliest input in it
+    void inputRendered(qint64 timestampNs);
+    void frameSkipped();
+    // a scene changed and needs to be rendered, also while rendering is paused
+    void sceneChanged();
 
 private slots:
-    void start();
     void cleanup();
 
-    void createFbo();
-    void destroyFbo();
-    bool loadQml(const QString &qmlFile, const QSize &size);
-
     void renderNext();
 
 private:
+    struct Layer
+    {
+        QQuickRenderControl *renderControl;
+        QQuickWindow *quickWindow;
+        QQmlComponent *qmlComponent;
+        QQuickItem *rootItem;
+        QOpenGLFramebufferObject *fbo;
+        QRect region;
+        int z;
+        QAtomicInt dirty;  // set by the scene, which may happen while the render thread renders
+        bool syncing;      // taking part in the frame being synced and rendered
+        QRect change;      // damage of the frame being rendered, in layer coordinates
+        DamageTracker damage;
+        QImage image;
+    };
+
+    void initialize();
+    QQmlEngine *engine();
+    Layer *createLayer(const QRect &region, int z);
+    void createFbo(Layer *layer, bool depthStencil);
+    static bool needsStencil(QQuickItem *item);
+    static qint64 textureBytes(QQuickItem *item);
+    void destroyLayer(Layer *layer);
+    bool loadQml(Layer *layer, const QString &qmlFile);
+    bool renderMono();
+    void polishLayers();
+    void syncLayers();
+    void renderLayers();
+    void readBack(Layer *layer, const QRect &rect);
+    void compose(const QRect &damage);
+    void emitFrame(const QImage &image, const QRect &damage);
+    void collectGarbageIfIdle(qint64 frameNsecs);
+
     QOpenGLContext *m_context;
     QOffscreenSurface *m_offscreenSurface;
-    QQuickRenderControl *m_renderControl;
-    QQuickWindow *m_quickWindow;
     QQmlEngine *m_qmlEngine;
-    QQmlComponent *m_qmlComponent;
-    QQuickItem *m_rootItem;
-    QOpenGLFramebufferObject *m_fbo;
+    bool m_lowMemory;
+    QList<Layer *> m_layers; // sorted by z, the first one is loaded by loadQmlFile
+    QImage m_composite;
+    MonoScene m_monoScene;
+    bool m_monoActive; // whether the last frame was drawn by m_monoScene
+    QThread *m_renderThread;
+    QObject *m_renderWorker; // lives in the render thread to run functions there
+    QAtomicInt m_renderBusy;
+    QMutex m_syncMutex;
+    QWaitCondition m_syncDone;
+    bool m_synced;
+    QAtomicInteger<quint64> m_framesDropped;
+    QAtomicInteger<quint64> m_framesRendered;
+    QAtomicInteger<quint64> m_framesSkipped;
+    qint64 m_pendingInput; // input not yet taken into a frame
+    qint64 m_frameInput;   // input shown by the frame being rendered
     qreal m_dpr;
     QSize m_size;
     AnimationDriver *m_animationDriver;
 
     Status m_status;
+    int m_pauseReasons; // PauseReason flags
     int m_fps;
     QTimer *m_renderTimer;
+
+    int m_gcInterval;
+    QElapsedTimer m_sinceGc;
+    QElapsedTimer m_sinceFrame;
+    qint64 m_lastGcNsecs;
+    FrameStatistics m_statistics;
 };
 
 #endif // OLEDRENDERER_H
@@ -0,0 +1,51 @@
+#include "panelkernels.h"
+
+const PanelKernel::SpreadTable PanelKernel::spreadTable;
+
+namespace {
+template <typename Controller, int Width, int Height>
+PanelKernels kernelsFor(bool specialised)
+{
+    PanelKernels kernels;
+    kernels.pack = &PanelKernel::pack<Controller, Width, Height>;
+    kernels.compose = &PanelKernel::compose<Controller, Width, Height>;
+    kernels.scan = &PanelKernel::scan<Controller, Width, Height>;
+    kernels.specialised = specialised;
+    return kernels;
+}
+
+template <typename Controller, int Width, int Height>
+PanelKernels gray4KernelsFor(bool specialised)
+{
+    PanelKernels kernels;
+    kernels.pack = &PanelKernel::packGray4<Controller, Width, Height>;
+    kernels.compose = &PanelKernel::copy<Controller, Width, Height>;
+    kernels.scan = &PanelKernel::scan<Controller, Width / 2, Height>;
+    kernels.specialised = specialised;
+    return kernels;
+}
+}
+
+PanelKernels PanelKernels::select(const QSize &size)
+{
+    if (size == QSize(128, 64)) {
+        return kernelsFor<Ssd1306Traits, 128, 64>(true);
+    } else if (size == QSize(128, 32)) {
+        return kernelsFor<Ssd1306Traits, 128, 32>(true);
+    } else if (size == QSize(96, 16)) {
+        return kernelsFor<Ssd1306Traits, 96, 16>(true);
+    } else if (size == QSize(64, 48)) {
+        return kernelsFor<Ssd1306Traits, 64, 48>(true);
+    }
+
+    return kernelsFor<Ssd1306Traits, 0, 0>(false);
+}
+
+PanelKernels PanelKernels::selectGray4(const QSize &size)
+{
+    if (size == QSize(256, 64)) {
+        return gray4KernelsFor<Ssd1322Traits, 256, 64>(true);
+    }
+
+    return gray4KernelsFor<Ssd1322Traits, 0, 0>(false);
+}
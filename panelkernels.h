@@ -0,0 +1,186 @@
+#ifndef PANELKERNELS_H
+#define PANELKERNELS_H
+
+#include <QRgb>
+#include <QSize>
+#include <QtGlobal>
+#include <stdint.h>
+#include <string.h>
+#include "transferplanner.h"
+
+// 1 bpp, eight lines per GDDRAM page
+struct Ssd1306Traits
+{
+    enum {
+        RamPages = 8,
+        RamLines = RamPages * 8,
+        MaxColumns = 128
+    };
+};
+
+// 4 bpp, every GDDRAM line is addressed on its own and holds two pixels per byte
+struct Ssd1322Traits
+{
+    enum {
+        RamPages = 64,
+        RamLines = RamPages,
+        MaxColumns = 256
+    };
+};
+
+// Per-panel pixel kernels. The specialised versions are instantiated with the panel geometry
+// as template arguments so loop bounds and buffer sizes are compile-time constants. Width and
+// Height of 0 select the generic version that uses the runtime size.
+struct PanelKernels
+{
+    // packs lines firstLine to firstLine + lines - 1 of the image into their place in the
+    // controller's frame layout, the range has to cover whole pages on paged controllers
+    typedef void (*PackFunction)(const uchar *bits, int bytesPerLine, int width, int height,
+                                 int firstLine, int lines, uint8_t *frame);
+    // maps the frame onto the GDDRAM for the given display start line
+    typedef void (*ComposeFunction)(const uint8_t *frame, const uint8_t *ram, int startLine,
+                                    int width, int height, uint8_t *target);
+    // collects the dirty spans between two GDDRAM images of unitBytes bytes per page or line
+    typedef void (*ScanFunction)(const uint8_t *from, const uint8_t *to, int unitBytes, DirtyMap &dirty);
+
+    PackFunction pack;
+    ComposeFunction compose;
+    ScanFunction scan;
+    bool specialised;
+
+    static PanelKernels select(const QSize &size);
+    static PanelKernels selectGray4(const QSize &size);
+};
+
+namespace PanelKernel {
+
+// expands the 8 pixels of a Format_Mono byte (MSB first) into bit 0 of 8 consecutive bytes
+struct SpreadTable
+{
+    uint64_t values[256];
+
+    SpreadTable()
+    {
+        for (int byte = 0; byte < 256; ++byte) {
+            uint64_t value = 0u;
+            for (int bit = 0; bit < 8; ++bit) {
+                value |= static_cast<uint64_t>((byte >> (7 - bit)) & 1) << (bit * 8);
+            }
+            values[byte] = value;
+        }
+    }
+};
+
+extern const SpreadTable spreadTable;
+
+inline uint64_t rotateLeft(uint64_t value, int shift)
+{
+    shift &= 63;
+    return shift == 0 ? value : ((value << shift) | (value >> (64 - shift)));
+}
+
+// packs a Format_Mono image into pages x width bytes, LSB is the top line of a page
+template <typename Controller, int Width, int Height>
+void pack(const uchar *bits, int bytesPerLine, int runtimeWidth, int runtimeHeight, int firstLine, int lines,
+          uint8_t *frame)
+{
+    const int width = Width > 0 ? Width : runtimeWidth;
+    const int pages = (Height > 0 ? Height : runtimeHeight) / 8;
+    const int lastPage = qMin(pages, (firstLine + lines) / 8);
+
+    // transposes 8x8 pixel blocks, each page line contributes one bit to eight column bytes
+    for (int page = firstLine / 8; page < lastPage; ++page) {
+        const uchar *rows = bits + page * 8 * bytesPerLine;
+        uint8_t *out = frame + page * width;
+        for (int block = 0; block < width / 8; ++block) {
+            uint64_t columns = 0u;
+            for (int i = 0; i < 8; ++i) {
+                columns |= spreadTable.values[rows[i * bytesPerLine + block]] << i;
+            }
+            for (int x = 0; x < 8; ++x) {
+                out[block * 8 + x] = static_cast<uint8_t>(columns >> (x * 8));
+            }
+        }
+    }
+}
+
+template <typename Controller, int Width, int Height>
+void compose(const uint8_t *frame, const uint8_t *ram, int startLine, int runtimeWidth, int runtimeHeight,
+             uint8_t *target)
+{
+    // Display line y shows GDDRAM line (startLine + y) % 64. Lines outside the multiplex ratio
+    // are not visible and keep their current content.
+    const int width = Width > 0 ? Width : runtimeWidth;
+    const int lines = Height > 0 ? Height : runtimeHeight;
+    const int pages = lines / 8;
+    const uint64_t visible = rotateLeft(lines == Controller::RamLines ? ~0ull : ((1ull << lines) - 1), startLine);
+
+    for (int x = 0; x < width; ++x) {
+        uint64_t frameColumn = 0u;
+        for (int page = 0; page < pages; ++page) {
+            frameColumn |= static_cast<uint64_t>(frame[page * width + x]) << (page * 8);
+        }
+        uint64_t ramColumn = 0u;
+        for (int page = 0; page < Controller::RamPages; ++page) {
+            ramColumn |= static_cast<uint64_t>(ram[page * width + x]) << (page * 8);
+        }
+
+        const uint64_t column = (ramColumn & ~visible) | rotateLeft(frameColumn, startLine);
+        for (int page = 0; page < Controller::RamPages; ++page) {
+            target[page * width + x] = static_cast<uint8_t>(column >> (page * 8));
+        }
+    }
+}
+
+// packs a RGB32 image into lines of two pixels per byte, the left pixel in the high nibble
+template <typename Controller, int Width, int Height>
+void packGray4(const uchar *bits, int bytesPerLine, int runtimeWidth, int runtimeHeight, int firstLine, int lines,
+               uint8_t *frame)
+{
+    const int width = Width > 0 ? Width : runtimeWidth;
+    const int height = qMin(Height > 0 ? Height : runtimeHeight, firstLine + lines);
+
+    // dark pixels light up, matching the 1 bpp threshold conversion
+    for (int y = firstLine; y < height; ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(bits + y * bytesPerLine);
+        uint8_t *out = frame + y * (width / 2);
+        for (int x = 0; x < width / 2; ++x) {
+            const int left = (255 - qGray(line[x * 2])) >> 4;
+            const int right = (255 - qGray(line[x * 2 + 1])) >> 4;
+            out[x] = static_cast<uint8_t>((left << 4) | right);
+        }
+    }
+}
+
+// the frame already has the GDDRAM layout, there is no start line offset to apply
+template <typename Controller, int Width, int Height>
+void copy(const uint8_t *frame, const uint8_t *, int, int runtimeWidth, int runtimeHeight, uint8_t *target)
+{
+    const int width = Width > 0 ? Width : runtimeWidth;
+    const int height = Height > 0 ? Height : runtimeHeight;
+    memcpy(target, frame, static_cast<size_t>(width / 2 * height));
+}
+
+template <typename Controller, int UnitBytes, int Height>
+void scan(const uint8_t *from, const uint8_t *to, int runtimeUnitBytes, DirtyMap &dirty)
+{
+    const int width = UnitBytes > 0 ? UnitBytes : runtimeUnitBytes;
+    dirty.reset(width, Controller::RamPages);
+
+    for (int page = 0; page < Controller::RamPages; ++page) {
+        const uint8_t *a = from + page * width;
+        const uint8_t *b = to + page * width;
+        if (memcmp(a, b, width) == 0) {
+            continue;
+        }
+        for (int x = 0; x < width; ++x) {
+            if (a[x] != b[x]) {
+                dirty.mark(page, x);
+            }
+        }
+    }
+}
+
+}
+
+#endif // PANELKERNELS_H
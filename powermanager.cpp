@@ -0,0 +1,182 @@
+#include "powermanager.h"
+
+#include <time.h>
+#include "oleddisplay.h"
+#include "oledrenderer.h"
+#include "ssd1306driver.h"
+
+namespace {
+// idle timeouts are whole seconds, a few checks per second are precise enough
+const int CHECK_INTERVAL_MS = 250;
+
+qint64 processCpuNsecs()
+{
+    timespec cpu;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    return static_cast<qint64>(cpu.tv_sec) * 1000000000 + cpu.tv_nsec;
+}
+
+const char *stateName(PowerManager::State state)
+{
+    switch (state) {
+    case PowerManager::Active:
+        return "active";
+    case PowerManager::Dimmed:
+        return "dimmed";
+    case PowerManager::Asleep:
+        return "asleep";
+    default:
+        return "unknown";
+    }
+}
+}
+
+PowerManager::PowerManager(OledRenderer *renderer, Ssd1306Driver *driver, OledDisplay *display, QObject *parent)
+    : QObject(parent)
+    , m_renderer(renderer)
+    , m_driver(driver)
+    , m_display(display)
+    , m_dimTimeout(0)
+    , m_sleepTimeout(0)
+    , m_dimContrast(16)
+    , m_fade(false)
+    , m_state(Active)
+    , m_wakes(0)
+    , m_cpuMark(0)
+    , m_bytesMark(0)
+{
+    for (int i = 0; i < StateCount; ++i) {
+        m_time[i] = 0;
+        m_cpu[i] = 0;
+        m_bytes[i] = 0;
+    }
+    connect(&m_timer, &QTimer::timeout, this, &PowerManager::checkIdle);
+}
+
+void PowerManager::setDimTimeout(int seconds)
+{
+    m_dimTimeout = seconds;
+}
+
+void PowerManager::setSleepTimeout(int seconds)
+{
+    m_sleepTimeout = seconds;
+}
+
+void PowerManager::setDimContrast(int contrast)
+{
+    m_dimContrast = contrast;
+}
+
+void PowerManager::setFadeEnabled(bool fade)
+{
+    m_fade = fade;
+}
+
+void PowerManager::start()
+{
+    m_sinceActivity.start();
+    m_sinceAccount.start();
+    m_cpuMark = processCpuNsecs();
+    m_bytesMark = m_driver->bytesWritten();
+    m_timer.start(CHECK_INTERVAL_MS);
+}
+
+PowerManager::State PowerManager::state() const
+{
+    return m_state;
+}
+
+void PowerManager::activity()
+{
+    m_sinceActivity.start();
+    if (m_state != Active) {
+        setState(Active);
+    }
+}
+
+void PowerManager::checkIdle()
+{
+    const qint64 idleMs = m_sinceActivity.elapsed();
+    State next = Active;
+    if ((m_sleepTimeout > 0) && (idleMs >= m_sleepTimeout * 1000LL)) {
+        next = Asleep;
+    } else if ((m_dimTimeout > 0) && (idleMs >= m_dimTimeout * 1000LL)) {
+        next = Dimmed;
+    }
+    if (next > m_state) {
+        setState(next);
+    }
+}
+
+void PowerManager::setState(State state)
+{
+    account();
+    const State previous = m_state;
+    m_state = state;
+
+    if (state == Active) {
+        // Contrast, fade state and power come back in one batched command before the changed frame
+        // is written, as the scene has them now, it may have changed them while the panel idled.
+        ++m_wakes;
+        emit wakeRequested(m_display->contrast(), (previous == Asleep) && m_display->isPowered(),
+                           m_display->fade() == OledDisplay::FadeOut, m_display->fade() == OledDisplay::Blink,
+                           m_display->fadeInterval());
+        if (m_renderer != nullptr) {
+            m_renderer->setRenderingPaused(false, OledRenderer::IdlePause);
+        }
+        return;
+    }
+
+    if ((previous == Active) && (m_renderer != nullptr)) {
+        m_renderer->setRenderingPaused(true, OledRenderer::IdlePause);
+    }
+    if (state == Dimmed) {
+        emit dimRequested(qMin(m_dimContrast, m_display->contrast()), m_fade);
+    } else if (m_display->isPowered()) {
+        emit sleepRequested();
+    }
+}
+
+void PowerManager::account()
+{
+    const qint64 cpu = processCpuNsecs();
+    const quint64 bytes = m_driver->bytesWritten();
+    m_time[m_state] += m_sinceAccount.nsecsElapsed();
+    m_cpu[m_state] += cpu - m_cpuMark;
+    m_bytes[m_state] += bytes - m_bytesMark;
+    m_sinceAccount.start();
+    m_cpuMark = cpu;
+    m_bytesMark = bytes;
+}
+
+QString PowerManager::summary()
+{
+    account();
+
+    // what idling saved is estimated from the bus and CPU rates while active
+    const qreal activeSeconds = m_time[Active] / 1e9;
+    const qreal idleSeconds = (m_time[Dimmed] + m_time[Asleep]) / 1e9;
+    const qreal idleBytes = m_bytes[Dimmed] + m_bytes[Asleep];
+    const qreal idleCpuMs = (m_cpu[Dimmed] + m_cpu[Asleep]) / 1e6;
+    const qreal activeByteRate = (activeSeconds > 0) ? m_bytes[Active] / activeSeconds : 0;
+    const qreal activeCpuRate = (activeSeconds > 0) ? m_cpu[Active] / 1e6 / activeSeconds : 0;
+    const qreal idleByteRate = (idleSeconds > 0) ? idleBytes / idleSeconds : 0;
+    const qreal idleCpuRate = (idleSeconds > 0) ? idleCpuMs / idleSeconds : 0;
+    const qreal savedBytes = qMax<qreal>(0, activeByteRate * idleSeconds - idleBytes);
+    const qreal savedCpuMs = qMax<qreal>(0, activeCpuRate * idleSeconds - idleCpuMs);
+
+    return QString("idle: state=%1 active=%2s dimmed=%3s asleep=%4s wakes=%5\n"
+                   "idle saving: bus %6 -> %7 B/s, cpu %8 -> %9 ms/s, saved %10 KiB and %11 ms cpu")
+            .arg(stateName(m_state))
+            .arg(m_time[Active] / 1000000000)
+            .arg(m_time[Dimmed] / 1000000000)
+            .arg(m_time[Asleep] / 1000000000)
+            .arg(m_wakes)
+            .arg(activeByteRate, 0, 'f', 0)
+            .arg(idleByteRate, 0, 'f', 0)
+            .arg(activeCpuRate, 0, 'f', 1)
+            .arg(idleCpuRate, 0, 'f', 1)
+            .arg(savedBytes / 1024, 0, 'f', 1)
+            .arg(savedCpuMs, 0, 'f', 0);
+}
@@ -0,0 +1,79 @@
+#ifndef POWERMANAGER_H
+#define POWERMANAGER_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class OledDisplay;
+class OledRenderer;
+class Ssd1306Driver;
+
+// Dims and then switches off the panel when nothing changed for a while, against burn-in and
+// to keep the bus quiet, and pauses rendering meanwhile. activity() wakes it up again, it is
+// connected to scene changes, frames from other processes and input. Contrast and power set
+// from QML through the oled context property are restored on waking.
+class PowerManager : public QObject
+{
+    Q_OBJECT
+public:
+    enum State {
+        Active,
+        Dimmed,
+        Asleep,
+        StateCount
+    };
+
+    // renderer may be null when frames come from other processes
+    PowerManager(OledRenderer *renderer, Ssd1306Driver *driver, OledDisplay *display, QObject *parent = 0);
+
+    // seconds without a change before dimming and switching off, 0 skips the step
+    void setDimTimeout(int seconds);
+    void setSleepTimeout(int seconds);
+    void setDimContrast(int contrast);
+    // dims with the controller's fade out instead of a lower contrast
+    void setFadeEnabled(bool fade);
+    void start();
+
+    State state() const;
+    // time, bus bytes and CPU time spent in every state and what idling saved compared to the
+    // rates while active
+    QString summary();
+
+public slots:
+    void activity();
+
+signals:
+    void dimRequested(int contrast, bool fade);
+    void sleepRequested();
+    void wakeRequested(int contrast, bool powerOn, bool fadeOut, bool blink, int fadeInterval);
+
+private slots:
+    void checkIdle();
+
+private:
+    void setState(State state);
+    void account();
+
+    OledRenderer *m_renderer;
+    Ssd1306Driver *m_driver;
+    OledDisplay *m_display;
+    int m_dimTimeout;
+    int m_sleepTimeout;
+    int m_dimContrast;
+    bool m_fade;
+    State m_state;
+    int m_wakes;
+    QTimer m_timer;
+    QElapsedTimer m_sinceActivity;
+
+    QElapsedTimer m_sinceAccount;
+    qint64 m_cpuMark;
+    quint64 m_bytesMark;
+    qint64 m_time[StateCount];
+    qint64 m_cpu[StateCount];
+    quint64 m_bytes[StateCount];
+};
+
+#endif // POWERMANAGER_H
@@ -1,18 +1,62 @@
 TEMPLATE = app
 
-QT += qml quick
+QT += qml quick quick-private network
 CONFIG += c++11
+LIBS += -lrt
 
 SOURCES += main.cpp \
     oledrenderer.cpp \
     animationdriver.cpp \
     ui2c-ssd1306.c \
-    ssd1306driver.cpp
+    ssd1306driver.cpp \
+    framestatistics.cpp \
+    oleddisplay.cpp \
+    transferplanner.cpp \
+    panelkernels.cpp \
+    oledcontroller.cpp \
+    temporalgrayscale.cpp \
+    ditherer.cpp \
+    animationcache.cpp \
+    framerecording.cpp \
+    ssd1306emulator.cpp \
+    sharedframesource.cpp \
+    damagetracker.cpp \
+    monoitems.cpp \
+    monoimageprovider.cpp \
+    threadtuning.cpp \
+    buttoninput.cpp \
+    powermanager.cpp \
+    metricsserver.cpp \
+    frametracer.cpp \
+    kernelbenchmark.cpp \
+    frameverifier.cpp
 
 HEADERS += \
     oledrenderer.h \
     animationdriver.h \
-    ssd1306driver.h
+    ssd1306driver.h \
+    framestatistics.h \
+    oleddisplay.h \
+    transferplanner.h \
+    panelkernels.h \
+    oledcontroller.h \
+    temporalgrayscale.h \
+    ditherer.h \
+    animationcache.h \
+    framerecording.h \
+    ssd1306emulator.h \
+    sharedframesource.h \
+    oled-frames.h \
+    damagetracker.h \
+    monoitems.h \
+    monoimageprovider.h \
+    threadtuning.h \
+    buttoninput.h \
+    powermanager.h \
+    metricsserver.h \
+    frametracer.h \
+    kernelbenchmark.h \
+    frameverifier.h
 
 # Additional import path used to resolve QML modules in Qt Creator's code model
 QML_IMPORT_PATH =
@@ -36,3 +80,8 @@ qnx: target.path = $$PREFIX/bin
 else: unix:!android: target.path = $$PREFIX/bin
 !isEmpty(target.path): INSTALLS += target
 
+# header for processes that feed frames through shared memory
+headers.files = oled-frames.h
+headers.path = $$PREFIX/include
+INSTALLS += headers
+
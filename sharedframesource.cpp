@@ -0,0 +1,198 @@
+#include "sharedframesource.h"
+
+#include <QDebug>
+#include <string.h>
+#include <sys/file.h>
+
+namespace {
+const size_t SLOT_ALIGNMENT = 64;
+
+size_t alignSlot(size_t bytes)
+{
+    return (bytes + SLOT_ALIGNMENT - 1) & ~(SLOT_ALIGNMENT - 1);
+}
+}
+
+SharedFrameSource::SharedFrameSource(QObject *parent)
+    : QThread(parent)
+    , m_file(-1)
+    , m_frames(nullptr)
+    , m_size(0)
+    , m_format(QImage::Format_Mono)
+    , m_shown(0)
+    , m_slot(0)
+    , m_intact(true)
+    , m_framesShown(0)
+    , m_framesTorn(0)
+{
+    connect(this, &SharedFrameSource::doorbellRung, this, &SharedFrameSource::takeFrame, Qt::QueuedConnection);
+}
+
+SharedFrameSource::~SharedFrameSource()
+{
+    close();
+}
+
+bool SharedFrameSource::open(const QString &name, const QSize &size, QImage::Format format)
+{
+    close();
+
+    const uint32_t bytesPerLine = (format == QImage::Format_Mono) ? size.width() / 8 : size.width() * 4;
+    const size_t slotOffset = alignSlot(sizeof(oled_frames));
+    const size_t slotBytes = alignSlot(static_cast<size_t>(bytesPerLine) * size.height());
+    const size_t segmentSize = slotOffset + OLED_FRAMES_SLOTS * slotBytes;
+
+    m_name = "/" + name;
+    const QByteArray path = m_name.toLocal8Bit();
+    // The renderer that created a segment keeps it locked. A segment nobody holds the lock of
+    // was left behind by a run that ended without cleaning up and still carries its old header.
+    const int existing = shm_open(path.constData(), O_RDWR | O_CLOEXEC, 0);
+    if (existing >= 0) {
+        const bool live = flock(existing, LOCK_EX | LOCK_NB) < 0;
+        ::close(existing);
+        if (live) {
+            qWarning() << "cannot create shared memory" << m_name << strerror(EEXIST);
+            return false;
+        }
+        shm_unlink(path.constData());
+    }
+    const int file = shm_open(path.constData(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0660);
+    if (file < 0) {
+        qWarning() << "cannot create shared memory" << m_name << strerror(errno);
+        return false;
+    }
+    if ((flock(file, LOCK_EX | LOCK_NB) < 0) || (ftruncate(file, static_cast<off_t>(segmentSize)) < 0)) {
+        qWarning() << "cannot set up shared memory" << m_name << strerror(errno);
+        ::close(file);
+        shm_unlink(path.constData());
+        return false;
+    }
+    void *map = mmap(nullptr, segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (map == MAP_FAILED) {
+        qWarning() << "cannot map shared memory" << m_name << strerror(errno);
+        ::close(file);
+        shm_unlink(path.constData());
+        return false;
+    }
+
+    m_file = file;
+
+    m_frames = static_cast<oled_frames *>(map);
+    m_size = segmentSize;
+    m_frameSize = size;
+    m_format = format;
+    m_shown = 0;
+
+    m_frames->version = OLED_FRAMES_VERSION;
+    m_frames->width = static_cast<uint32_t>(size.width());
+    m_frames->height = static_cast<uint32_t>(size.height());
+    m_frames->format = (format == QImage::Format_Mono) ? OLED_FRAMES_MONO : OLED_FRAMES_RGB32;
+    m_frames->bytes_per_line = bytesPerLine;
+    m_frames->slot_count = OLED_FRAMES_SLOTS;
+    m_frames->slot_offset = static_cast<uint32_t>(slotOffset);
+    m_frames->slot_bytes = static_cast<uint32_t>(slotBytes);
+    __atomic_store_n(&m_frames->magic, OLED_FRAMES_MAGIC, __ATOMIC_RELEASE);
+
+    m_stopping.store(0);
+    start();
+    return true;
+}
+
+void SharedFrameSource::close()
+{
+    if (m_frames == nullptr) {
+        return;
+    }
+
+    m_stopping.store(1);
+    __atomic_fetch_add(&m_frames->doorbell, 1u, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &m_frames->doorbell, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+    wait();
+
+    munmap(m_frames, m_size);
+    shm_unlink(m_name.toLocal8Bit().constData());
+    ::close(m_file);
+    m_file = -1;
+    m_frames = nullptr;
+    m_size = 0;
+}
+
+quint64 SharedFrameSource::framesShown() const
+{
+    return m_framesShown;
+}
+
+quint64 SharedFrameSource::framesTorn() const
+{
+    return m_framesTorn;
+}
+
+QString SharedFrameSource::summary() const
+{
+    return QString("shm: shown=%1 torn=%2").arg(m_framesShown).arg(m_framesTorn);
+}
+
+bool SharedFrameSource::isFrameIntact()
+{
+    // the packed pixels have to be read before the sequence is checked again
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    m_intact = (__atomic_load_n(&m_frames->slots[m_slot].sequence, __ATOMIC_RELAXED) == m_shown);
+    return m_intact;
+}
+
+void SharedFrameSource::run()
+{
+    uint32_t seen = __atomic_load_n(&m_frames->doorbell, __ATOMIC_ACQUIRE);
+    while (m_stopping.load() == 0) {
+        __atomic_store_n(&m_frames->waiting, 1u, __ATOMIC_SEQ_CST);
+        // a producer that rang before it saw the waiting flag has already moved the doorbell
+        if (__atomic_load_n(&m_frames->doorbell, __ATOMIC_SEQ_CST) == seen) {
+            syscall(SYS_futex, &m_frames->doorbell, FUTEX_WAIT, seen, nullptr, nullptr, 0);
+        }
+        __atomic_store_n(&m_frames->waiting, 0u, __ATOMIC_SEQ_CST);
+
+        const uint32_t doorbell = __atomic_load_n(&m_frames->doorbell, __ATOMIC_ACQUIRE);
+        if (doorbell != seen) {
+            seen = doorbell;
+            emit doorbellRung();
+        }
+    }
+}
+
+void SharedFrameSource::takeFrame()
+{
+    if (m_frames == nullptr) {
+        return;
+    }
+
+    const int bytesPerLine = static_cast<int>(m_frames->bytes_per_line);
+    for (uint32_t attempt = 0; attempt < OLED_FRAMES_SLOTS; ++attempt) {
+        // only the newest complete frame is shown, older ones are dropped
+        int newest = -1;
+        uint32_t sequence = m_shown;
+        for (uint32_t slot = 0; slot < OLED_FRAMES_SLOTS; ++slot) {
+            const uint32_t current = __atomic_load_n(&m_frames->slots[slot].sequence, __ATOMIC_ACQUIRE);
+            if ((current != 0) && (static_cast<int32_t>(current - sequence) > 0)) {
+                newest = static_cast<int>(slot);
+                sequence = current;
+            }
+        }
+        if (newest < 0) {
+            return;
+        }
+
+        // packed straight from the slot, isFrameIntact() tells whether that raced with a producer
+        const QImage frame(oled_frames_slot_bits(m_frames, static_cast<uint32_t>(newest)),
+                           m_frameSize.width(), m_frameSize.height(), bytesPerLine, m_format);
+        m_shown = sequence;
+        m_slot = static_cast<uint32_t>(newest);
+        m_intact = true;
+        emit frameReady(frame);
+        if (m_intact) {
+            ++m_framesShown;
+            return;
+        }
+        // the slot was claimed again while it was packed, take the newer frame right away
+        ++m_framesTorn;
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef SHAREDFRAMESOURCE_H
+#define SHAREDFRAMESOURCE_H
+
+#include <QAtomicInt>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QThread>
+#include "oled-frames.h"
+
+// Takes frames from other processes through the shared memory segment described in
+// oled-frames.h. The thread only waits for the doorbell, frames are taken in the thread the
+// source lives in. Frames are emitted as images over their slot, without a copy. Whoever packs
+// one asks isFrameIntact() before sending it, a frame whose slot was claimed again meanwhile is
+// dropped there and the newer one is taken right away. The segment is locked while it is open,
+// a second instance with the same name fails instead of taking it over.
+class SharedFrameSource : public QThread
+{
+    Q_OBJECT
+public:
+    explicit SharedFrameSource(QObject *parent = 0);
+    ~SharedFrameSource();
+
+    // creates the segment /name for frames of the given size in Format_Mono or Format_RGB32
+    bool open(const QString &name, const QSize &size, QImage::Format format);
+    void close();
+
+    // whether the slot of the frame being emitted still holds it, asked after packing it
+    bool isFrameIntact();
+
+    quint64 framesShown() const;
+    quint64 framesTorn() const;
+    QString summary() const;
+
+signals:
+    void frameReady(const QImage &frame);
+    void doorbellRung();
+
+protected:
+    void run() override;
+
+private slots:
+    void takeFrame();
+
+private:
+    QString m_name;
+    int m_file; // holds the lock that tells a live segment from a stale one
+    oled_frames *m_frames;
+    size_t m_size;
+    QSize m_frameSize;
+    QImage::Format m_format;
+    QAtomicInt m_stopping;
+    uint32_t m_shown;
+    uint32_t m_slot;  // slot of the frame being emitted
+    bool m_intact;    // false once isFrameIntact() found the slot claimed again
+    quint64 m_framesShown;
+    quint64 m_framesTorn;
+};
+
+#endif // SHAREDFRAMESOURCE_H
@@ -1,82 +1,596 @@
 #include "ssd1306driver.h"
-#include <QVector>
-#include <QRgb>
-#include <stdint.h>
+#include "frametracer.h"
+#include "panelkernels.h"
+#include "transferplanner.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <string.h>
 
 extern "C" {
     int i2c_open(int bus);
     int i2c_select(int file, int addr);
-    int ssd1306_init(int file, int col, int line);
-    int ssd1306_cls(int file, int col, int line);
+    int i2c_set_timeout(int file, int ms);
     int i2c_write_data(int file, uint8_t data[], size_t len);
 }
 
+namespace {
+// how far the content may move between two frames and still be scrolled in hardware
+const int MAX_SCROLL_LINES = 16;
+
+// A frame makes a single attempt and stops at its first failed transfer, so it waits at most one
+// transfer timeout for the bus. The next frames retry right away a few times, after that frames
+// are dropped without touching the bus during a backoff that doubles up to a second.
+const int RETRY_BUDGET = 2;
+const int MIN_BACKOFF_MS = 10;
+const int MAX_BACKOFF_MS = 1000;
+}
+
 Ssd1306Driver::Ssd1306Driver(QObject *parent)
     : QObject(parent)
+    , m_controller(OledController::create(OledController::SSD1306))
+    , m_type(OledController::SSD1306)
     , m_file(-1)
+    , m_units(0)
+    , m_unitBytes(0)
+    , m_hardwareScroll(false)
+    , m_startLine(0)
+    , m_mode(TransferPlan::Horizontal)
+    , m_idle(false)
+    , m_kernels(PanelKernels::select(QSize()))
+    , m_frameValid(false)
+    , m_bytesWritten(0)
+    , m_framesWritten(0)
+    , m_transferTimeout(100)
+    , m_resync(false)
+    , m_backoffMs(0)
+    , m_failures(0)
+    , m_busErrors(0)
+    , m_retries(0)
+    , m_resyncs(0)
+    , m_framesSkipped(0)
+    , m_inputTimestamp(0)
 {
 
 }
 
-bool Ssd1306Driver::openDevice(QSize size, int busId, int address)
+void Ssd1306Driver::setController(OledController::Type type)
 {
-    m_file = i2c_open(busId);
     if (m_file < 0) {
+        m_controller.reset(OledController::create(type));
+        m_type = type;
+    }
+}
+
+void Ssd1306Driver::setRecordingFile(const QString &fileName)
+{
+    m_recordingFile = fileName;
+}
+
+bool Ssd1306Driver::openDevice(QSize size, int busId, int address)
+{
+    const int file = i2c_open(busId);
+    if (file < 0) {
         return false;
     }
 
-    int res = i2c_select(m_file, address);
+    int res = i2c_select(file, address);
     if (res < 0) {
         return false;
     }
+    // without a timeout a hung adapter would block the thread writing frames
+    i2c_set_timeout(file, m_transferTimeout);
 
-    ssd1306_init(m_file, size.width(), size.height());
-    ssd1306_cls(m_file, size.width(), size.height()); // SSD1306 may have a SRAM-based GDDRAM, some parts of the graphic are perserved after power cycle.
+    return openFile(size, file);
+}
 
+bool Ssd1306Driver::openFile(QSize size, int file)
+{
+    if (file < 0) {
+        return false;
+    }
+    if (!m_controller->supports(size)) {
+        qWarning() << "display size" << size << "is not supported by the controller";
+        return false;
+    }
+
+    int res = m_controller->init(file, size);
+    if (res < 0) {
+        return false;
+    }
+
+    m_file = file;
     m_size = size;
+    m_units = m_controller->ramUnits(size);
+    m_unitBytes = m_controller->unitBytes(size);
+    m_mode = m_controller->defaultMode();
+    m_kernels = m_controller->kernels(size);
+    m_mono.fill(0, size.width() / 8 * size.height());
+    m_frame.fill(0, m_controller->frameBytes(size));
+    m_frameValid = false;
+    m_resync = false;
+    m_backoffMs = 0;
+    m_failures = 0;
+    m_ram.fill(0, m_units * m_unitBytes);
+    m_target = m_ram;
+    m_scratch = m_ram;
+    m_transfer.reserve(m_units * m_unitBytes + 1);
+
+    if (!m_recordingFile.isEmpty() && !m_recorder.open(m_recordingFile, m_type, size, m_units, m_unitBytes)) {
+        m_file = -1;
+        return false;
+    }
+
+    // SSD1306 may have a SRAM-based GDDRAM, some parts of the graphic are perserved after power cycle.
+    clearScreen();
 
     return true;
 }
 
+void Ssd1306Driver::setHardwareScrollEnabled(bool enabled)
+{
+    m_hardwareScroll = enabled;
+}
+
+void Ssd1306Driver::setDitherMode(Ditherer::Mode mode)
+{
+    m_ditherer.setMode(mode);
+}
+
+void Ssd1306Driver::setTransferTimeout(int ms)
+{
+    m_transferTimeout = ms;
+}
+
+const FrameStatistics &Ssd1306Driver::statistics() const
+{
+    return m_statistics;
+}
+
+quint64 Ssd1306Driver::bytesWritten() const
+{
+    return m_bytesWritten.load();
+}
+
+quint64 Ssd1306Driver::framesWritten() const
+{
+    return m_framesWritten.load();
+}
+
+quint64 Ssd1306Driver::busErrors() const
+{
+    return m_busErrors.load();
+}
+
+quint64 Ssd1306Driver::busRetries() const
+{
+    return m_retries.load();
+}
+
+quint64 Ssd1306Driver::busResyncs() const
+{
+    return m_resyncs.load();
+}
+
+quint64 Ssd1306Driver::framesSkipped() const
+{
+    return m_framesSkipped.load();
+}
+
+QString Ssd1306Driver::busSummary() const
+{
+    return QString("bus: errors=%1 retries=%2 resyncs=%3 skipped=%4")
+            .arg(m_busErrors.load()).arg(m_retries.load()).arg(m_resyncs.load()).arg(m_framesSkipped.load());
+}
+
+QImage::Format Ssd1306Driver::imageFormat() const
+{
+    return m_controller->imageFormat();
+}
+
+const QVector<uint8_t> &Ssd1306Driver::ram() const
+{
+    return m_ram;
+}
+
+int Ssd1306Driver::ramUnits() const
+{
+    return m_units;
+}
+
+int Ssd1306Driver::unitBytes() const
+{
+    return m_unitBytes;
+}
+
+int Ssd1306Driver::startLine() const
+{
+    return m_startLine;
+}
+
+TransferPlan::Mode Ssd1306Driver::mode() const
+{
+    return m_mode;
+}
+
+bool Ssd1306Driver::account(int res)
+{
+    if (res < 0) {
+        m_busErrors.fetchAndAddRelaxed(1);
+        return false;
+    }
+    m_bytesWritten.fetchAndAddRelaxed(static_cast<quint64>(res));
+    return true;
+}
+
+bool Ssd1306Driver::busReady()
+{
+    if (m_resync && m_backoff.isValid() && (m_backoff.elapsed() < m_backoffMs)) {
+        m_framesSkipped.fetchAndAddRelaxed(1);
+        // the packed frame misses the damage of the dropped image
+        m_frameValid = false;
+        return false;
+    }
+    return true;
+}
+
+void Ssd1306Driver::failFrame()
+{
+    if (!m_resync) {
+        qWarning() << "display bus error, the display is updated completely once it responds again";
+    }
+    m_resync = true;
+    // the first failures are retried by the next frames, the frames after them wait for the backoff
+    if (++m_failures <= RETRY_BUDGET) {
+        m_retries.fetchAndAddRelaxed(1);
+        m_backoffMs = 0;
+    } else {
+        m_backoffMs = qBound(MIN_BACKOFF_MS, m_backoffMs * 2, MAX_BACKOFF_MS);
+    }
+    m_backoff.start();
+}
+
+void Ssd1306Driver::recordInputLatency(bool shown)
+{
+    // input that did not change the frame is never shown, it has no latency to record
+    if (m_inputTimestamp != 0) {
+        if (shown) {
+            m_statistics.addSample(FrameStatistics::InputLatency,
+                                   FrameStatistics::monotonicNsecs() - m_inputTimestamp);
+        }
+        m_inputTimestamp = 0;
+    }
+}
+
+void Ssd1306Driver::markInput(qint64 timestampNs)
+{
+    if ((m_inputTimestamp == 0) || (timestampNs < m_inputTimestamp)) {
+        m_inputTimestamp = timestampNs;
+    }
+}
+
+void Ssd1306Driver::refresh()
+{
+    m_refresh.store(1);
+}
+
 void Ssd1306Driver::clearScreen()
+{
+    if (m_file < 0) {
+        return;
+    }
+
+    // Clear the whole GDDRAM, not only the visible lines, so the mirror is valid for every start line.
+    m_target.fill(0);
+    writeRam(fullPlan(), 0);
+    m_frameValid = false;
+}
+
+TransferPlan Ssd1306Driver::fullPlan() const
+{
+    TransferPlan plan;
+    plan.mode = m_controller->defaultMode();
+    if (plan.mode == TransferPlan::Page) {
+        for (int unit = 0; unit < m_units; ++unit) {
+            TransferSpan span = {unit, unit, 0, m_unitBytes - 1};
+            plan.spans.append(span);
+        }
+    } else {
+        TransferSpan span = {0, m_units - 1, 0, m_unitBytes - 1};
+        plan.spans.append(span);
+    }
+    return plan;
+}
+
+void Ssd1306Driver::setContrast(int contrast)
+{
+    // a change while idle would undo the dim, wake() applies the contrast of that moment
+    if ((m_file > -1) && !m_idle) {
+        account(m_controller->setContrast(m_file, contrast));
+    }
+}
+
+void Ssd1306Driver::setInverted(bool inverted)
 {
     if (m_file > -1) {
-        ssd1306_cls(m_file, m_size.width(), m_size.height());
+        account(m_controller->setInverted(m_file, inverted));
+    }
+}
+
+void Ssd1306Driver::setPowered(bool powered)
+{
+    if (m_file > -1) {
+        account(m_controller->setPowered(m_file, powered));
+    }
+}
+
+void Ssd1306Driver::setFade(bool fadeOut, bool blink, int interval)
+{
+    if ((m_file > -1) && !m_idle) {
+        account(m_controller->setFade(m_file, fadeOut, blink, interval));
+    }
+}
+
+void Ssd1306Driver::dim(int contrast, bool fade)
+{
+    m_idle = true;
+    if (m_file > -1) {
+        // the fade engine dims to black on its own, slowly enough to go unnoticed
+        account(fade ? m_controller->setFade(m_file, true, false, 64) : m_controller->setContrast(m_file, contrast));
+    }
+}
+
+void Ssd1306Driver::sleep()
+{
+    m_idle = true;
+    if (m_file > -1) {
+        account(m_controller->setPowered(m_file, false));
+    }
+}
+
+void Ssd1306Driver::wake(int contrast, bool powerOn, bool fadeOut, bool blink, int interval)
+{
+    m_idle = false;
+    if (m_file > -1) {
+        account(m_controller->wake(m_file, contrast, powerOn, fadeOut, blink, interval));
     }
 }
 
 void Ssd1306Driver::close()
 {
+    m_recorder.close();
     m_file = -1; // TODO: close file ?
 }
 
-void Ssd1306Driver::writeImage(const QImage &image)
+void Ssd1306Driver::writeImage(const QImage &image, const QRect &damage)
 {
-    const uint8_t SSD1306_CONT_DATA_HDR = 0x40;
+    writeFrame(image, damage, std::function<bool()>());
+}
 
+bool Ssd1306Driver::writeSharedImage(const QImage &image, const std::function<bool()> &unchanged)
+{
+    return writeFrame(image, image.rect(), unchanged);
+}
+
+bool Ssd1306Driver::writeFrame(const QImage &image, const QRect &damage, const std::function<bool()> &unchanged)
+{
     if (m_file < 0) {
+        return true;
+    }
+    if ((image.width() < m_size.width()) || (image.height() < m_size.height())) {
+        return true;
+    }
+    if (!busReady()) {
+        recordInputLatency(false);
+        return true;
+    }
+
+    // Only the lines of the damaged rectangle are converted and packed, widened to whole pages.
+    // Error diffusion carries into every line below the damage and depends on every line above
+    // it, so those modes always convert the whole frame.
+    const QImage::Format format = m_controller->imageFormat();
+    const int unitLines = (format == QImage::Format_Mono) ? 8 : 1;
+    int firstLine = 0;
+    int lastLine = m_size.height();
+    if (m_frameValid && !m_resync && (m_refresh.load() == 0)) {
+        const QRect lines = damage & QRect(QPoint(0, 0), m_size);
+        if (lines.isEmpty()) {
+            recordInputLatency(false);
+            return true;
+        }
+        if (!m_ditherer.diffusesErrors()) {
+            firstLine = lines.top() / unitLines * unitLines;
+            lastLine = (lines.bottom() / unitLines + 1) * unitLines;
+        }
+    }
+    const int lineCount = lastLine - firstLine;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (image.format() == format) {
+        TraceSpan span("pack", lineCount);
+        m_kernels.pack(image.constBits(), image.bytesPerLine(), m_size.width(), m_size.height(), firstLine, lineCount,
+                       m_frame.data());
+    } else if (format == QImage::Format_Mono) {
+        // dither straight into reused scanlines instead of converting the whole image
+        const bool rgb = (image.format() == QImage::Format_RGB32) || (image.format() == QImage::Format_ARGB32)
+                || (image.format() == QImage::Format_ARGB32_Premultiplied);
+        const int bytesPerLine = m_size.width() / 8;
+        {
+            TraceSpan span("convert", lastLine - firstLine);
+            const QImage source = rgb ? image : image.convertToFormat(QImage::Format_RGB32);
+            m_ditherer.dither(source, m_size.width(), lastLine, m_mono.data(), bytesPerLine, firstLine);
+        }
+        TraceSpan span("pack", lineCount);
+        m_kernels.pack(m_mono.constData(), bytesPerLine, m_size.width(), m_size.height(), firstLine, lineCount,
+                       m_frame.data());
+    } else {
+        QImage converted;
+        {
+            TraceSpan span("convert", m_size.height());
+            converted = image.convertToFormat(format);
+        }
+        TraceSpan span("pack", lineCount);
+        m_kernels.pack(converted.constBits(), converted.bytesPerLine(), m_size.width(), m_size.height(), firstLine,
+                       lineCount, m_frame.data());
+    }
+    m_frameValid = true;
+    m_statistics.addSample(FrameStatistics::Pack, timer.nsecsElapsed());
+    if (unchanged && !unchanged()) {
+        // the pixels were overwritten while they were packed, the packed frame is torn
+        m_frameValid = false;
+        recordInputLatency(false);
+        return false;
+    }
+    timer.restart();
+
+    TraceSpan span("transfer");
+    const int startLine = (m_hardwareScroll && m_controller->canScroll()) ? findStartLine() : m_startLine;
+    m_kernels.compose(m_frame.constData(), m_ram.constData(), startLine, m_size.width(), m_size.height(), m_target.data());
+    const bool written = writeRam(planTransfer(m_target), startLine);
+    m_statistics.addSample(FrameStatistics::Transfer, timer.nsecsElapsed());
+    recordInputLatency(written);
+    return true;
+}
+
+TransferPlan Ssd1306Driver::planTransfer(const QVector<uint8_t> &ram)
+{
+    return planTransfer(m_ram.constData(), ram.constData(), m_mode);
+}
+
+TransferPlan Ssd1306Driver::planTransfer(const uint8_t *from, const uint8_t *to, TransferPlan::Mode mode)
+{
+    m_kernels.scan(from, to, m_unitBytes, m_dirty);
+    return TransferPlanner::plan(m_dirty, mode, m_controller->canSwitchMode());
+}
+
+void Ssd1306Driver::writeRam(const uint8_t *ram, int startLine, const TransferPlan &plan)
+{
+    if ((m_file < 0) || !busReady()) {
         return;
     }
 
-    int height = m_size.height() / 8;
-    int width = m_size.width();
-    int len = height * width + 1;
+    TraceSpan span("transfer");
+    QElapsedTimer timer;
+    timer.start();
+
+    memcpy(m_target.data(), ram, static_cast<size_t>(m_target.size()));
+    const bool written = writeRam(plan, startLine);
+    // the packed frame no longer matches the GDDRAM, the next image is packed completely
+    m_frameValid = false;
+    m_statistics.addSample(FrameStatistics::Transfer, timer.nsecsElapsed());
+    recordInputLatency(written);
+}
+
+int Ssd1306Driver::findStartLine()
+{
+    // Content that moved vertically by whole lines can be shown by moving the display start line,
+    // after which only the newly exposed lines differ from the GDDRAM.
+    const int lines = m_controller->startLines();
+    int bestLine = m_startLine;
+    m_kernels.compose(m_frame.constData(), m_ram.constData(), m_startLine, m_size.width(), m_size.height(), m_scratch.data());
+    int bestCost = planTransfer(m_scratch).cost;
+
+    for (int shift = -MAX_SCROLL_LINES; (shift <= MAX_SCROLL_LINES) && (bestCost > 0); ++shift) {
+        if (shift == 0) {
+            continue;
+        }
+        const int line = (m_startLine + shift + lines) % lines;
+        m_kernels.compose(m_frame.constData(), m_ram.constData(), line, m_size.width(), m_size.height(), m_scratch.data());
+        const int cost = planTransfer(m_scratch).cost + TransferPlanner::CommandBytes;
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestLine = line;
+        }
+    }
+
+    return bestLine;
+}
+
+bool Ssd1306Driver::writeRam(const TransferPlan &requested, int startLine)
+{
+    const uint8_t SSD1306_CONT_DATA_HDR = 0x40;
+    const int width = m_unitBytes;
+    const uint8_t *ram = m_target.constData();
+
+    // After a bus error the GDDRAM, start line and addressing mode of the controller are unknown
+    // and everything is sent again, as it is on request.
+    const bool resync = m_resync || (m_refresh.fetchAndStoreRelaxed(0) != 0);
+    const TransferPlan plan = resync ? fullPlan() : requested;
+
+    if (resync || (startLine != m_startLine)) {
+        TraceSpan span("i2c start line");
+        if (!account(m_controller->setStartLine(m_file, startLine))) {
+            failFrame();
+            return false;
+        }
+        m_startLine = startLine;
+    }
+    if (!plan.isEmpty() && (resync || (plan.mode != m_mode))) {
+        TraceSpan span("i2c mode");
+        if (!account(m_controller->setMode(m_file, plan.mode))) {
+            failFrame();
+            return false;
+        }
+        m_mode = plan.mode;
+    }
+
+    for (TransferSpan span : plan.spans) {
+        m_controller->alignSpan(span);
 
-    QVector<uint8_t> vector(len);
-    int pos = 0;
-    vector[pos] = SSD1306_CONT_DATA_HDR;
-    pos++;
+        m_transfer.resize(span.size() + 1);
+        int pos = 0;
+        m_transfer[pos] = SSD1306_CONT_DATA_HDR;
+        pos++;
 
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            uint8_t pixel = 0u;
-            for (int i = 0; i < 8; ++i) {
-                pixel |= static_cast<uint8_t>(image.pixelIndex(x, y * 8 + i) == 1) << i;
+        if (plan.mode == TransferPlan::Vertical) {
+            for (int x = span.firstColumn; x <= span.lastColumn; ++x) {
+                for (int page = span.firstPage; page <= span.lastPage; ++page) {
+                    m_transfer[pos] = ram[page * width + x];
+                    pos++;
+                }
+            }
+        } else {
+            for (int page = span.firstPage; page <= span.lastPage; ++page) {
+                for (int x = span.firstColumn; x <= span.lastColumn; ++x) {
+                    m_transfer[pos] = ram[page * width + x];
+                    pos++;
+                }
             }
-            vector[pos] = pixel;
-            pos++;
+        }
+
+        if (!writeSpan(plan.mode, span)) {
+            failFrame();
+            return false;
         }
     }
 
-    i2c_write_data(m_file, vector.data(), static_cast<size_t>(vector.size()));
+    if (m_resync) {
+        qWarning() << "display bus recovered";
+        m_resyncs.fetchAndAddRelaxed(1);
+        m_resync = false;
+        m_backoffMs = 0;
+        m_failures = 0;
+    }
+    // only frames that reached the panel are recorded
+    m_recorder.append(ram, startLine, plan);
+    m_ram.swap(m_target);
+    m_framesWritten.fetchAndAddRelaxed(1);
+    return true;
+}
+
+bool Ssd1306Driver::writeSpan(TransferPlan::Mode mode, const TransferSpan &span)
+{
+    // The window is selected for every span, a failed transfer leaves the column and page
+    // pointers of the controller wherever it stopped.
+    {
+        TraceSpan trace("i2c select");
+        if (!account(m_controller->selectSpan(m_file, mode, span))) {
+            return false;
+        }
+    }
+    TraceSpan trace("i2c write", m_transfer.size());
+    const int res = i2c_write_data(m_file, m_transfer.data(), static_cast<size_t>(m_transfer.size()));
+    return account((res < 0) ? res : m_transfer.size());
 }
@@ -1,9 +1,22 @@
 #ifndef SSD1306DRIVER_H
 #define SSD1306DRIVER_H
 
+#include <QAtomicInteger>
+#include <QElapsedTimer>
 #include <QObject>
+#include <QRect>
+#include <QScopedPointer>
 #include <QSize>
 #include <QImage>
+#include <QVector>
+#include <functional>
+#include <stdint.h>
+#include "ditherer.h"
+#include "framerecording.h"
+#include "framestatistics.h"
+#include "oledcontroller.h"
+#include "panelkernels.h"
+#include "transferplanner.h"
 
 class Ssd1306Driver : public QObject
 {
@@ -12,15 +25,117 @@ public:
     explicit Ssd1306Driver(QObject *parent = 0);
 
     bool openDevice(QSize size, int bus_id = 2, int address = 0x3c);
+    // uses a bus that is already open with the display selected, e.g. an emulator
+    bool openFile(QSize size, int file);
     void close();
 
+    void setController(OledController::Type type);
+    // records everything written to the GDDRAM from the next openDevice() on
+    void setRecordingFile(const QString &fileName);
+    void setHardwareScrollEnabled(bool enabled);
+    void setDitherMode(Ditherer::Mode mode);
+    // how long the I2C adapter may take for one transfer before it fails, set by openDevice()
+    void setTransferTimeout(int ms);
+
+    quint64 bytesWritten() const;
+    quint64 framesWritten() const;
+    quint64 busErrors() const;
+    quint64 busRetries() const;
+    quint64 busResyncs() const;
+    // frames dropped during the backoff after a bus error
+    quint64 framesSkipped() const;
+    QString busSummary() const;
+    const FrameStatistics &statistics() const;
+
+    // the format writeImage() packs without converting
+    QImage::Format imageFormat() const;
+
+    // GDDRAM mirror after the last write, ramUnits() x unitBytes() bytes
+    const QVector<uint8_t> &ram() const;
+    int ramUnits() const;
+    int unitBytes() const;
+    int startLine() const;
+    TransferPlan::Mode mode() const;
+
+    // plans the transfer from one GDDRAM image to another with the panel's kernels
+    TransferPlan planTransfer(const uint8_t *from, const uint8_t *to, TransferPlan::Mode mode);
+    // writes a GDDRAM image with a plan made against the current GDDRAM content
+    void writeRam(const uint8_t *ram, int startLine, const TransferPlan &plan);
+    // Packs a frame in memory that another process may overwrite meanwhile, without copying it.
+    // unchanged() is asked once the frame is packed, nothing of it is sent when it returns false.
+    bool writeSharedImage(const QImage &image, const std::function<bool()> &unchanged);
+
 public slots:
-    void writeImage(const QImage &image);
+    // only the lines covered by damage are packed again, an empty damage means nothing changed
+    void writeImage(const QImage &image, const QRect &damage);
     void clearScreen();
+    // sends the next frame completely, with the start line and addressing mode, may be called from any thread
+    void refresh();
+    // the next write shows input given at timestampNs, CLOCK_MONOTONIC, and records its latency
+    void markInput(qint64 timestampNs);
+
+    void setContrast(int contrast);
+    void setInverted(bool inverted);
+    void setPowered(bool powered);
+    void setFade(bool fadeOut, bool blink, int interval);
+
+    // idle power states, the GDDRAM keeps the frame while the panel is off
+    void dim(int contrast, bool fade);
+    void sleep();
+    void wake(int contrast, bool powerOn, bool fadeOut, bool blink, int interval);
 
 private:
+    // returns false when unchanged() dropped the frame after packing
+    bool writeFrame(const QImage &image, const QRect &damage, const std::function<bool()> &unchanged);
+    TransferPlan planTransfer(const QVector<uint8_t> &ram);
+    TransferPlan fullPlan() const;
+    int findStartLine();
+    // sends the spans of the plan from m_target, which becomes the GDDRAM mirror when it succeeds
+    bool writeRam(const TransferPlan &plan, int startLine);
+    bool writeSpan(TransferPlan::Mode mode, const TransferSpan &span);
+    bool account(int res);
+    bool busReady();
+    void failFrame();
+    void recordInputLatency(bool shown);
+
+    QScopedPointer<OledController> m_controller;
+    OledController::Type m_type;
     QSize m_size;
     int m_file;
+    int m_units;
+    int m_unitBytes;
+    bool m_hardwareScroll;
+    int m_startLine;
+    TransferPlan::Mode m_mode;
+    bool m_idle; // dimmed or asleep, contrast and fade changes are applied by wake()
+    PanelKernels m_kernels;
+    bool m_frameValid; // whether m_frame holds the last image, so damage can be packed alone
+    DirtyMap m_dirty;
+    Ditherer m_ditherer;
+    // counters are read by monitoring from other threads
+    QAtomicInteger<quint64> m_bytesWritten;
+    QAtomicInteger<quint64> m_framesWritten;
+    int m_transferTimeout;
+    bool m_resync;        // the controller state is unknown after a bus error, the next frame is sent completely
+    QAtomicInt m_refresh; // the next frame is sent completely on request
+    int m_backoffMs;      // frames are dropped for this long after a failed one
+    int m_failures;       // failed frames in a row, the first ones are retried without a backoff
+    QElapsedTimer m_backoff;
+    QAtomicInteger<quint64> m_busErrors;
+    QAtomicInteger<quint64> m_retries;
+    QAtomicInteger<quint64> m_resyncs;
+    QAtomicInteger<quint64> m_framesSkipped;
+    FrameStatistics m_statistics;
+    qint64 m_inputTimestamp; // input waiting for the write that shows it, 0 without one
+    QString m_recordingFile;
+    FrameRecorder m_recorder;
+
+    QVector<uchar> m_mono;       // dithered 1 bpp scanlines of the frame being packed
+    QVector<uint8_t> m_frame;    // logical frame in the controller's packed format
+    QVector<uint8_t> m_ram;      // mirror of the GDDRAM, m_units x m_unitBytes
+    QVector<uint8_t> m_target;   // GDDRAM content for the frame being written
+    QVector<uint8_t> m_scratch;  // candidate GDDRAM content while searching a scroll offset
+    QVector<uint8_t> m_transfer; // data header followed by one span of the transfer plan
 };
 
 #endif // SSD1306DRIVER_H
@@ -0,0 +1,274 @@
+#include "ssd1306emulator.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+const int COLUMNS = 128;
+const int PAGES = 8;
+// a transfer of this single byte is not a valid control byte on its own, sync() sends it
+const uint8_t SYNC_MARKER = 0xff;
+// an emulator thread that stopped reading must not hang the caller
+const qint64 SYNC_TIMEOUT_MS = 1000;
+
+// parameter bytes that follow a command
+int parameterCount(uint8_t command)
+{
+    switch (command) {
+    case 0x20: // memory addressing mode
+    case 0x23: // fade out and blinking
+    case 0x81: // contrast
+    case 0x8d: // charge pump
+    case 0xa8: // multiplex ratio
+    case 0xd3: // display offset
+    case 0xd5: // clock divide ratio
+    case 0xd6: // zoom in
+    case 0xd9: // pre-charge period
+    case 0xda: // COM pins
+    case 0xdb: // VCOMH deselect level
+        return 1;
+    case 0x21: // column address
+    case 0x22: // page address
+    case 0xa3: // vertical scroll area
+        return 2;
+    case 0x29: // vertical and horizontal scroll
+    case 0x2a:
+        return 5;
+    case 0x26: // horizontal scroll
+    case 0x27:
+        return 6;
+    default:
+        return 0;
+    }
+}
+}
+
+Ssd1306Emulator::Ssd1306Emulator(QObject *parent)
+    : QThread(parent)
+    , m_syncs(0)
+    , m_busFile(-1)
+    , m_deviceFile(-1)
+    , m_gddram(PAGES * COLUMNS, 0)
+    , m_mode(2)
+    , m_columnStart(0)
+    , m_columnEnd(COLUMNS - 1)
+    , m_pageStart(0)
+    , m_pageEnd(PAGES - 1)
+    , m_column(0)
+    , m_page(0)
+    , m_startLine(0)
+    , m_received(0)
+    , m_expected(0)
+    , m_messages(0)
+    , m_bytes(0)
+{
+
+}
+
+Ssd1306Emulator::~Ssd1306Emulator()
+{
+    close();
+}
+
+bool Ssd1306Emulator::supports(OledController::Type type)
+{
+    return (type == OledController::SSD1306) || (type == OledController::SSD1309);
+}
+
+int Ssd1306Emulator::open()
+{
+    if (m_busFile >= 0) {
+        return -EBUSY;
+    }
+
+    int files[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, files) < 0) {
+        return -errno;
+    }
+    m_busFile = files[0];
+    m_deviceFile = files[1];
+    start();
+    return m_busFile;
+}
+
+void Ssd1306Emulator::close()
+{
+    if (m_busFile < 0) {
+        return;
+    }
+
+    // the emulator sees the end of the stream once it has read everything before it
+    shutdown(m_busFile, SHUT_WR);
+    wait();
+    ::close(m_busFile);
+    ::close(m_deviceFile);
+    m_busFile = -1;
+    m_deviceFile = -1;
+}
+
+bool Ssd1306Emulator::sync()
+{
+    if (m_busFile < 0) {
+        return false;
+    }
+
+    // the mutex is not held while sending, a full socket would block the emulator thread on it
+    m_mutex.lock();
+    const quint64 expected = m_syncs + 1;
+    m_mutex.unlock();
+    if (send(m_busFile, &SYNC_MARKER, 1, 0) != 1) {
+        return false;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    QMutexLocker locker(&m_mutex);
+    while (m_syncs < expected) {
+        const qint64 remaining = SYNC_TIMEOUT_MS - timer.elapsed();
+        if ((remaining <= 0) || !m_synced.wait(&m_mutex, static_cast<unsigned long>(remaining))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QVector<uint8_t> Ssd1306Emulator::gddram() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_gddram;
+}
+
+int Ssd1306Emulator::startLine() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_startLine;
+}
+
+quint64 Ssd1306Emulator::messages() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_messages;
+}
+
+quint64 Ssd1306Emulator::bytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytes;
+}
+
+void Ssd1306Emulator::run()
+{
+    uint8_t message[16384];
+    for (;;) {
+        const ssize_t length = recv(m_deviceFile, message, sizeof(message), 0);
+        if ((length < 0) && (errno == EINTR)) {
+            continue;
+        }
+        if (length <= 0) {
+            break;
+        }
+        QMutexLocker locker(&m_mutex);
+        receive(message, static_cast<int>(length));
+    }
+}
+
+void Ssd1306Emulator::receive(const uint8_t *message, int length)
+{
+    if ((length == 1) && (message[0] == SYNC_MARKER)) {
+        ++m_syncs;
+        m_synced.wakeAll();
+        return;
+    }
+
+    ++m_messages;
+    m_bytes += static_cast<quint64>(length);
+
+    // A control byte with the continuation bit applies to the next byte only and is followed by
+    // another control byte, otherwise it applies to the rest of the transfer.
+    int pos = 0;
+    while (pos < length) {
+        const uint8_t control = message[pos++];
+        const bool isData = (control & 0x40) != 0;
+        const int end = (control & 0x80) ? qMin(pos + 1, length) : length;
+        for (; pos < end; ++pos) {
+            if (isData) {
+                data(message[pos]);
+            } else {
+                command(message[pos]);
+            }
+        }
+    }
+}
+
+void Ssd1306Emulator::command(uint8_t byte)
+{
+    if (m_expected == 0) {
+        m_received = 0;
+        m_expected = parameterCount(byte) + 1;
+    }
+    m_command[m_received++] = byte;
+    if (m_received == m_expected) {
+        execute();
+        m_expected = 0;
+    }
+}
+
+void Ssd1306Emulator::execute()
+{
+    const uint8_t command = m_command[0];
+
+    if (command <= 0x0f) {
+        m_column = (m_column & 0xf0) | command;
+    } else if (command <= 0x1f) {
+        m_column = ((command & 0x07) << 4) | (m_column & 0x0f);
+    } else if ((command >= 0x40) && (command <= 0x7f)) {
+        m_startLine = command & 0x3f;
+    } else if ((command >= 0xb0) && (command <= 0xb7)) {
+        m_page = command & 0x07;
+    } else if (command == 0x20) {
+        if (m_command[1] <= 2) {
+            m_mode = m_command[1];
+        }
+    } else if (command == 0x21) {
+        m_columnStart = m_command[1] & 0x7f;
+        m_columnEnd = m_command[2] & 0x7f;
+        m_column = m_columnStart;
+    } else if (command == 0x22) {
+        m_pageStart = m_command[1] & 0x07;
+        m_pageEnd = m_command[2] & 0x07;
+        m_page = m_pageStart;
+    }
+    // the remaining commands only change how the GDDRAM is shown
+}
+
+void Ssd1306Emulator::data(uint8_t byte)
+{
+    m_gddram[m_page * COLUMNS + m_column] = byte;
+
+    switch (m_mode) {
+    case 0:
+        if (++m_column > m_columnEnd) {
+            m_column = m_columnStart;
+            if (++m_page > m_pageEnd) {
+                m_page = m_pageStart;
+            }
+        }
+        break;
+    case 1:
+        if (++m_page > m_pageEnd) {
+            m_page = m_pageStart;
+            if (++m_column > m_columnEnd) {
+                m_column = m_columnStart;
+            }
+        }
+        break;
+    default:
+        // page addressing wraps within the page
+        if (++m_column >= COLUMNS) {
+            m_column = 0;
+        }
+        break;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef SSD1306EMULATOR_H
+#define SSD1306EMULATOR_H
+
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include <stdint.h>
+#include "oledcontroller.h"
+
+// Stands in for a SSD1306 on the I2C bus. The driver writes to one end of a SOCK_SEQPACKET
+// socket pair, which keeps every write a message of its own just like an I2C transfer, and the
+// emulator thread decodes the commands and data from the other end into its own GDDRAM.
+class Ssd1306Emulator : public QThread
+{
+public:
+    explicit Ssd1306Emulator(QObject *parent = 0);
+    ~Ssd1306Emulator();
+
+    static bool supports(OledController::Type type);
+
+    // returns the bus end for Ssd1306Driver::openFile, or a negative error
+    int open();
+    // ends the connection and waits until everything sent before has been processed
+    void close();
+    // waits until everything sent before has been processed, the bus stays open, false when the
+    // emulator did not get there within a second
+    bool sync();
+
+    // 8 pages of 128 columns
+    QVector<uint8_t> gddram() const;
+    int startLine() const;
+    quint64 messages() const;
+    quint64 bytes() const;
+
+protected:
+    void run() override;
+
+private:
+    void receive(const uint8_t *message, int length);
+    void command(uint8_t byte);
+    void execute();
+    void data(uint8_t byte);
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_synced;
+    quint64 m_syncs;
+    int m_busFile;
+    int m_deviceFile;
+
+    QVector<uint8_t> m_gddram;
+    int m_mode;
+    int m_columnStart;
+    int m_columnEnd;
+    int m_pageStart;
+    int m_pageEnd;
+    int m_column;
+    int m_page;
+    int m_startLine;
+
+    uint8_t m_command[8];
+    int m_received;
+    int m_expected;
+
+    quint64 m_messages;
+    quint64 m_bytes;
+};
+
+#endif // SSD1306EMULATOR_H
@@ -0,0 +1,126 @@
+#include "temporalgrayscale.h"
+
+TemporalGrayscale::TemporalGrayscale(QObject *parent)
+    : QObject(parent)
+    , m_levels(0)
+    , m_subFrameRate(0)
+    , m_plane(0)
+    , m_nextDeadline(0)
+    , m_interval(0)
+    , m_missed(0)
+    , m_shown(0)
+{
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, &QTimer::timeout, this, &TemporalGrayscale::showNextPlane);
+}
+
+void TemporalGrayscale::start(int levels, int subFrameRate)
+{
+    // the timer runs at whole milliseconds, report against the rate it can actually hit
+    const int intervalMs = qMax(1, 1000 / qMax(1, subFrameRate));
+    m_levels = qBound(2, levels, 4);
+    m_subFrameRate = 1000 / intervalMs;
+    m_interval = intervalMs * 1000000LL;
+    m_planes.resize(m_levels - 1);
+    m_plane = 0;
+    m_missed = 0;
+    m_shown = 0;
+
+    m_clock.start();
+    m_rateTimer.start();
+    m_nextDeadline = m_interval;
+    m_timer.start(intervalMs);
+}
+
+void TemporalGrayscale::stop()
+{
+    m_timer.stop();
+}
+
+void TemporalGrayscale::setFrame(const QImage &image)
+{
+    const QImage frame = image.convertToFormat(QImage::Format_RGB32);
+    const int width = frame.width();
+    const int height = frame.height();
+    const int planes = m_planes.size();
+
+    for (int plane = 0; plane < planes; ++plane) {
+        QImage &bits = m_planes[plane];
+        if (bits.size() != frame.size()) {
+            bits = QImage(frame.size(), QImage::Format_Mono);
+            bits.setColorCount(2);
+            bits.setColor(0, qRgb(255, 255, 255));
+            bits.setColor(1, qRgb(0, 0, 0));
+        }
+        bits.fill(0);
+    }
+
+    // dark pixels light up, as with the threshold conversion
+    for (int y = 0; y < height; ++y) {
+        const QRgb *line = reinterpret_cast<const QRgb *>(frame.constScanLine(y));
+        for (int x = 0; x < width; ++x) {
+            const int level = ((255 - qGray(line[x])) * planes + 127) / 255;
+            const uchar mask = static_cast<uchar>(0x80 >> (x & 7));
+            for (int plane = 0; plane < level; ++plane) {
+                m_planes[plane].scanLine(y)[x >> 3] |= mask;
+            }
+        }
+    }
+}
+
+void TemporalGrayscale::showNextPlane()
+{
+    if (m_planes.isEmpty() || m_planes.first().isNull()) {
+        return;
+    }
+
+    // a sub-frame that starts after its successor was due has been shown too long
+    const qint64 now = m_clock.nsecsElapsed();
+    if (now > m_nextDeadline + m_interval) {
+        m_missed += static_cast<int>((now - m_nextDeadline) / m_interval);
+        m_nextDeadline = now;
+    }
+    m_nextDeadline += m_interval;
+
+    QElapsedTimer writeTimer;
+    writeTimer.start();
+    emit planeReady(m_planes.at(m_plane));
+    m_statistics.addSample(FrameStatistics::SubFrame, writeTimer.nsecsElapsed());
+
+    m_plane = (m_plane + 1) % m_planes.size();
+    m_shown++;
+}
+
+qreal TemporalGrayscale::achievedRate()
+{
+    const qint64 elapsed = m_rateTimer.restart();
+    const qreal rate = elapsed > 0 ? (m_shown * 1000.0 / elapsed) : 0.0;
+    m_shown = 0;
+    return rate;
+}
+
+int TemporalGrayscale::targetRate() const
+{
+    return m_subFrameRate;
+}
+
+int TemporalGrayscale::missedSubFrames() const
+{
+    return m_missed;
+}
+
+const FrameStatistics &TemporalGrayscale::statistics() const
+{
+    return m_statistics;
+}
+
+QString TemporalGrayscale::summary()
+{
+    return QString("grayscale: %1 levels, %2 of %3 sub-frames/s, %4 missed, write p99=%5us budget=%6us")
+            .arg(m_levels)
+            .arg(achievedRate(), 0, 'f', 1)
+            .arg(m_subFrameRate)
+            .arg(m_missed)
+            .arg(m_statistics.quantile(FrameStatistics::SubFrame, 0.99) / 1000)
+            .arg(m_interval / 1000);
+}
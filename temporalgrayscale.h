@@ -0,0 +1,56 @@
+#ifndef TEMPORALGRAYSCALE_H
+#define TEMPORALGRAYSCALE_H
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include "framestatistics.h"
+
+// Shows grey levels on a monochrome panel by cycling bit planes of the rendered frame at a
+// sub-frame rate well above the render rate. A pixel of level l out of n levels is lit in l of
+// the n - 1 planes.
+class TemporalGrayscale : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TemporalGrayscale(QObject *parent = 0);
+
+    void start(int levels, int subFrameRate);
+    void stop();
+
+    // sub-frames shown per second since the last call
+    qreal achievedRate();
+    int targetRate() const;
+    int missedSubFrames() const;
+    const FrameStatistics &statistics() const;
+
+    QString summary();
+
+public slots:
+    void setFrame(const QImage &image);
+
+signals:
+    void planeReady(const QImage &plane);
+
+private slots:
+    void showNextPlane();
+
+private:
+    int m_levels;
+    int m_subFrameRate;
+    int m_plane;
+    QVector<QImage> m_planes;
+    QTimer m_timer;
+
+    QElapsedTimer m_clock;
+    qint64 m_nextDeadline;
+    qint64 m_interval;
+    int m_missed;
+    int m_shown;
+    QElapsedTimer m_rateTimer;
+    FrameStatistics m_statistics;
+};
+
+#endif // TEMPORALGRAYSCALE_H
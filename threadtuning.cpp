@@ -0,0 +1,98 @@
+#include "threadtuning.h"
+
+#include <QDebug>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+// touched once so the stack of a realtime thread does not fault while it works
+const size_t PREFAULT_STACK_BYTES = 64 * 1024;
+
+void touchStack()
+{
+    volatile unsigned char stack[PREFAULT_STACK_BYTES];
+    for (size_t i = 0; i < PREFAULT_STACK_BYTES; i += 4096) {
+        stack[i] = 0;
+    }
+}
+}
+
+ThreadTuning::ThreadTuning()
+    : cpu(-1)
+    , policy(SCHED_OTHER)
+    , priority(0)
+    , prefaultStack(false)
+{
+
+}
+
+bool ThreadTuning::isEmpty() const
+{
+    return (cpu < 0) && (policy == SCHED_OTHER) && !prefaultStack;
+}
+
+bool ThreadTuning::apply(const char *name) const
+{
+    bool ok = true;
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        const int res = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (res != 0) {
+            qWarning() << "cannot pin the" << name << "thread to CPU" << cpu << strerror(res);
+            ok = false;
+        }
+    }
+    if (policy != SCHED_OTHER) {
+        sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = priority;
+        const int res = pthread_setschedparam(pthread_self(), policy, &param);
+        if (res != 0) {
+            qWarning() << "cannot give the" << name << "thread realtime priority" << priority << strerror(res);
+            ok = false;
+        }
+    }
+    if (prefaultStack) {
+        touchStack();
+    }
+    return ok;
+}
+
+bool ThreadTuning::parsePolicy(const QString &name, int *policy)
+{
+    const QString lower = name.toLower();
+    if (lower == "fifo") {
+        *policy = SCHED_FIFO;
+    } else if (lower == "rr") {
+        *policy = SCHED_RR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool ThreadTuning::parseCpu(const QString &value, int *cpu)
+{
+    bool ok;
+    const int number = value.toInt(&ok);
+    if (!ok || (number < 0) || (number >= sysconf(_SC_NPROCESSORS_CONF))) {
+        return false;
+    }
+    *cpu = number;
+    return true;
+}
+
+bool ThreadTuning::lockMemory()
+{
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+        qWarning() << "cannot lock memory" << strerror(errno);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,30 @@
+#ifndef THREADTUNING_H
+#define THREADTUNING_H
+
+#include <QString>
+#include <sched.h>
+
+// CPU affinity and realtime scheduling for the thread that applies it. Realtime policies need
+// CAP_SYS_NICE or an RLIMIT_RTPRIO, failures are reported and leave the thread as it was.
+struct ThreadTuning
+{
+    int cpu;      // -1 keeps the inherited affinity
+    int policy;   // SCHED_OTHER keeps the inherited scheduling
+    int priority; // 1 to 99 for SCHED_FIFO and SCHED_RR
+    bool prefaultStack;
+
+    ThreadTuning();
+
+    bool isEmpty() const;
+    // applies the settings to the calling thread, name is used in warnings
+    bool apply(const char *name) const;
+
+    // "fifo" or "rr"
+    static bool parsePolicy(const QString &name, int *policy);
+    // a CPU number below the count of configured CPUs
+    static bool parseCpu(const QString &value, int *cpu);
+    // locks current and future pages so page faults cannot stall a frame
+    static bool lockMemory();
+};
+
+#endif // THREADTUNING_H
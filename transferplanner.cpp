@@ -0,0 +1,131 @@
+#include "transferplanner.h"
+
+#include <QVarLengthArray>
+
+namespace {
+typedef QVarLengthArray<TransferSpan, 16> SpanList;
+
+TransferSpan united(const TransferSpan &a, const TransferSpan &b)
+{
+    TransferSpan span = {qMin(a.firstPage, b.firstPage), qMax(a.lastPage, b.lastPage),
+                         qMin(a.firstColumn, b.firstColumn), qMax(a.lastColumn, b.lastColumn)};
+    return span;
+}
+
+int windowCost(const TransferSpan &span)
+{
+    return TransferPlanner::WindowCommandBytes + span.size() + 1;
+}
+
+// Greedily merges neighbouring windows whenever sending the clean bytes between them is cheaper
+// than addressing a second window.
+void appendMerged(const SpanList &spans, TransferPlan &plan)
+{
+    plan.cost = 0;
+    for (const TransferSpan &span : spans) {
+        if (!plan.spans.isEmpty()) {
+            TransferSpan &previous = plan.spans.last();
+            const TransferSpan merged = united(previous, span);
+            if (windowCost(merged) <= windowCost(previous) + windowCost(span)) {
+                plan.cost += windowCost(merged) - windowCost(previous);
+                previous = merged;
+                continue;
+            }
+        }
+        plan.spans.append(span);
+        plan.cost += windowCost(span);
+    }
+}
+}
+
+void DirtyMap::reset(int width, int pages)
+{
+    this->width = width;
+    this->pages = pages;
+    pageFirst.resize(pages);
+    pageLast.resize(pages);
+    columnFirst.resize(width);
+    columnLast.resize(width);
+    for (int page = 0; page < pages; ++page) {
+        pageFirst[page] = width;
+        pageLast[page] = -1;
+    }
+    for (int x = 0; x < width; ++x) {
+        columnFirst[x] = pages;
+        columnLast[x] = -1;
+    }
+}
+
+TransferPlan TransferPlanner::plan(const uint8_t *from, const uint8_t *to, int width, int pages,
+                                   TransferPlan::Mode current, bool allowModeSwitch)
+{
+    DirtyMap dirty;
+    dirty.reset(width, pages);
+    for (int page = 0; page < pages; ++page) {
+        for (int x = 0; x < width; ++x) {
+            if (from[page * width + x] != to[page * width + x]) {
+                dirty.mark(page, x);
+            }
+        }
+    }
+    return plan(dirty, current, allowModeSwitch);
+}
+
+TransferPlan TransferPlanner::plan(const DirtyMap &dirty, TransferPlan::Mode current, bool allowModeSwitch)
+{
+    SpanList pageSpans;
+    for (int page = 0; page < dirty.pages; ++page) {
+        if (dirty.pageLast[page] >= 0) {
+            TransferSpan span = {page, page, dirty.pageFirst[page], dirty.pageLast[page]};
+            pageSpans.append(span);
+        }
+    }
+
+    TransferPlan best;
+    best.mode = current;
+    best.cost = 0;
+    if (pageSpans.isEmpty()) {
+        return best;
+    }
+
+    SpanList columnSpans;
+    for (int x = 0; x < dirty.width; ++x) {
+        if (dirty.columnLast[x] >= 0) {
+            TransferSpan span = {dirty.columnFirst[x], dirty.columnLast[x], x, x};
+            columnSpans.append(span);
+        }
+    }
+
+    TransferPlan candidates[3];
+
+    candidates[TransferPlan::Horizontal].mode = TransferPlan::Horizontal;
+    appendMerged(pageSpans, candidates[TransferPlan::Horizontal]);
+
+    candidates[TransferPlan::Vertical].mode = TransferPlan::Vertical;
+    appendMerged(columnSpans, candidates[TransferPlan::Vertical]);
+
+    // page addressing cannot cross pages, but also needs no window setup
+    TransferPlan &pageMode = candidates[TransferPlan::Page];
+    pageMode.mode = TransferPlan::Page;
+    pageMode.cost = 0;
+    for (const TransferSpan &span : pageSpans) {
+        pageMode.spans.append(span);
+        pageMode.cost += PageCommandBytes + span.size() + 1;
+    }
+
+    bool found = false;
+    for (TransferPlan &candidate : candidates) {
+        if (candidate.mode != current) {
+            if (!allowModeSwitch) {
+                continue;
+            }
+            candidate.cost += ModeCommandBytes;
+        }
+        if (!found || (candidate.cost < best.cost)) {
+            best = candidate;
+            found = true;
+        }
+    }
+
+    return best;
+}
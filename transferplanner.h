@@ -0,0 +1,73 @@
+#ifndef TRANSFERPLANNER_H
+#define TRANSFERPLANNER_H
+
+#include <QVarLengthArray>
+#include <QVector>
+#include <stdint.h>
+
+struct TransferSpan
+{
+    int firstPage;
+    int lastPage;
+    int firstColumn;
+    int lastColumn;
+
+    int size() const { return (lastPage - firstPage + 1) * (lastColumn - firstColumn + 1); }
+};
+
+// dirty column range of every page and dirty page range of every column
+struct DirtyMap
+{
+    int width;
+    int pages;
+    QVarLengthArray<int, 8> pageFirst;
+    QVarLengthArray<int, 8> pageLast;
+    QVarLengthArray<int, 132> columnFirst;
+    QVarLengthArray<int, 132> columnLast;
+
+    void reset(int width, int pages);
+
+    inline void mark(int page, int column)
+    {
+        pageFirst[page] = qMin(pageFirst[page], column);
+        pageLast[page] = column;
+        columnFirst[column] = qMin(columnFirst[column], page);
+        columnLast[column] = page;
+    }
+};
+
+struct TransferPlan
+{
+    // values match the SSD1306 memory addressing mode parameter
+    enum Mode {
+        Horizontal = 0,
+        Vertical = 1,
+        Page = 2
+    };
+
+    Mode mode;
+    QVector<TransferSpan> spans;
+    int cost;
+
+    bool isEmpty() const { return spans.isEmpty(); }
+};
+
+class TransferPlanner
+{
+public:
+    // Bus bytes per command byte, every command travels in its own control + command transfer.
+    static const int CommandBytes = 2;
+    static const int WindowCommandBytes = 6 * CommandBytes;
+    static const int PageCommandBytes = 3 * CommandBytes;
+    static const int ModeCommandBytes = 2 * CommandBytes;
+
+    // Plans the cheapest transfer of the dirty bytes, starting with the controller in
+    // addressing mode "current".
+    static TransferPlan plan(const DirtyMap &dirty, TransferPlan::Mode current, bool allowModeSwitch = true);
+
+    // Same for the GDDRAM content "from" to "to", both laid out as pages x width bytes.
+    static TransferPlan plan(const uint8_t *from, const uint8_t *to, int width, int pages,
+                             TransferPlan::Mode current, bool allowModeSwitch = true);
+};
+
+#endif // TRANSFERPLANNER_H
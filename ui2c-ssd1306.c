@@ -12,8 +12,10 @@
 #include <sys/ioctl.h>
 
 #include <malloc.h>
+#include <string.h>
 #include <strings.h>
 #include <signal.h>
+#include <time.h>
 #include <png.h>
 
 /*
@@ -78,6 +80,17 @@ int i2c_select(int file, int addr) {
   return res;
 }
 
+int i2c_set_timeout(int file, int ms) {
+  /* I2C_TIMEOUT is in units of 10 ms, the adapter gives up on a transfer after it */
+  int res;
+
+  if ((res = ioctl(file, I2C_TIMEOUT, (unsigned long)((ms + 9) / 10))) < 0) {
+    perror("ioctl() I2C_TIMEOUT failed");
+  }
+
+  return res;
+}
+
 /******************************************************************************
  * Device is mostly write-only.
  * Frame format: address control data
@@ -86,12 +99,55 @@ int i2c_select(int file, int addr) {
  * Repeat with CONT set until all command and data are sent.
  *****************************************************************************/
 
+/* A dead bus fails every transfer of every frame, so failures are reported at most once a second
+ * together with the count of the ones left out. The caller counts every failure itself. */
+static void i2c_report(const char *what) {
+  static struct timespec last_report;
+  static unsigned long suppressed;
+  const int error = errno;
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (((last_report.tv_sec != 0) || (last_report.tv_nsec != 0)) && (now.tv_sec - last_report.tv_sec < 1)) {
+    suppressed++;
+    return;
+  }
+  if (suppressed > 0) {
+    fprintf(stderr, "%s: %s (%lu more failures since the last report)\n", what, strerror(error), suppressed);
+  } else {
+    fprintf(stderr, "%s: %s\n", what, strerror(error));
+  }
+  last_report = now;
+  suppressed = 0;
+  errno = error;
+}
+
 int i2c_write_cmd_1b(int file, uint8_t cmd) {
   int res;
   uint8_t buf[2] = {SSD1306_CTRL_CMD, cmd};
 
   if ((res = (int)write(file, buf, 2)) < 0) {
-    perror("write() command failed");
+    i2c_report("write() command failed");
+    return res;
+  }
+
+  return 0;
+}
+
+#define SSD1306_CMD_STREAM_MAX (32)
+/* Commands in one transfer: a single control byte with CONT cleared, all further bytes are commands. */
+int i2c_write_cmds(int file, const uint8_t cmds[], size_t len) {
+  int res;
+  uint8_t buf[SSD1306_CMD_STREAM_MAX + 1];
+
+  if ((NULL == cmds) || (len > SSD1306_CMD_STREAM_MAX)) {
+    return -EINVAL;
+  }
+
+  buf[0] = SSD1306_CTRL_CMD;
+  memcpy(buf + 1, cmds, len);
+  if ((res = (int)write(file, buf, len + 1)) < 0) {
+    i2c_report("write() commands failed");
     return res;
   }
 
@@ -111,7 +167,7 @@ int i2c_write_data(int file, uint8_t data[], size_t len) {
   }
 
   if ((res = (int)write(file, data, len)) < 0) {
-    perror("write() data failed");
+    i2c_report("write() data failed");
     return res;
   }
 
@@ -126,7 +182,7 @@ int i2c_read_byte(int file, uint8_t *data) {
   int res;
 
   if ((res = (int)read(file, data, 1)) < 0) {
-    perror("read() data failed");
+    i2c_report("read() data failed");
     return res;
   }
 
@@ -139,7 +195,7 @@ int i2c_read_byte(int file, uint8_t *data) {
 int ssd1306_set_contrast(int file, uint8_t contrast) {
   int res;
 
-  if ((res = i2c_write_cmd_1b(file, 0x80)) < 0 ) {
+  if ((res = i2c_write_cmd_1b(file, 0x81)) < 0 ) {
     return res;
   }
   if ((res = i2c_write_cmd_1b(file, contrast)) < 0) {
@@ -360,7 +416,7 @@ int ssd1306_set_col_start(int file, uint8_t col) {
   if ((res = i2c_write_cmd_1b(file, 0x00 | (col & 0x0f))) < 0 ) {
     return res;
   }
-  if ((res = i2c_write_cmd_1b(file, 0x01 | (col > 4))) < 0 ) {
+  if ((res = i2c_write_cmd_1b(file, 0x10 | ((col >> 4) & 0x0f))) < 0 ) {
     return res;
   }
 
@@ -637,8 +693,10 @@ int ssd1306_send_nop(int file) {
  * NOTE: the following 3 are added in the new versions of the datasheet,
  * however, the charge pump enable is essential for most modules to operate.
  */
-int ssd1306_set_fade(int file, bool fade_out, bool fade_in, uint8_t fade_interval) {
+int ssd1306_set_fade(int file, bool fade_out, bool blink, uint8_t fade_interval) {
   int res;
+  /* A[5:4]: 00b disabled, 10b fade out, 11b blink, 01b is reserved */
+  const uint8_t mode = blink ? 0x30 : (fade_out ? 0x20 : 0x00);
 
   if (fade_interval > 128) {
     return -EINVAL;
@@ -650,7 +708,7 @@ int ssd1306_set_fade(int file, bool fade_out, bool fade_in, uint8_t fade_interva
   if ((res = i2c_write_cmd_1b(file, 0x23)) < 0 ) {
     return res;
   }
-  if ((res = i2c_write_cmd_1b(file, (fade_out ? 0x20 : 0x00) | (fade_in ? 0x10 : 0x00) | ((fade_interval / 8 - 1) & 0x0f))) < 0 ) {
+  if ((res = i2c_write_cmd_1b(file, mode | ((fade_interval / 8 - 1) & 0x0f))) < 0 ) {
     return res;
   }
 
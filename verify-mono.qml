@@ -0,0 +1,84 @@
+import QtQuick 2.6
+import Oled 1.0
+
+// Reference scene for --verify on the CPU path: Mono items only, so every frame is drawn into
+// 1 bpp lines without the scene graph. It scrolls, clips, changes a corner and changes the whole
+// panel like verify.qml.
+Item {
+    id: root
+    width: 128
+    height: 64
+
+    property int tick: 0
+
+    Timer {
+        running: true
+        repeat: true
+        interval: 100
+        onTriggered: root.tick++
+    }
+
+    // moves up one line per tick, hardware scrolling and the start line have to follow it
+    Column {
+        x: 0
+        y: 16 - (root.tick % 48)
+        width: 80
+
+        Repeater {
+            model: 8
+            MonoRect {
+                width: 80
+                height: 8
+                filled: (index % 2) === 1
+
+                MonoRect {
+                    x: index * 9
+                    y: 2
+                    width: 8
+                    height: 4
+                }
+            }
+        }
+    }
+
+    // only a few columns change, damage and the line diff of the CPU path send just those
+    MonoText {
+        x: 88
+        y: 2
+        text: root.tick
+        font.pixelSize: 12
+    }
+
+    // a clipped item moving through its parent, partly outside of it
+    Item {
+        x: 84
+        y: 20
+        width: 40
+        height: 40
+        clip: true
+
+        MonoRect {
+            width: 40
+            height: 40
+            filled: false
+            borderWidth: 2
+        }
+
+        MonoBarGraph {
+            x: (root.tick % 20) - 10
+            y: 4
+            width: 36
+            height: 32
+            spacing: 1
+            values: [root.tick % 7, (root.tick + 3) % 7, (root.tick + 5) % 7, 6]
+            maximum: 6
+        }
+    }
+
+    // every few seconds the whole panel changes at once
+    MonoRect {
+        width: 128
+        height: 64
+        visible: (root.tick % 30) >= 28
+    }
+}
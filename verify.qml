@@ -0,0 +1,77 @@
+import QtQuick 2.6
+
+// Reference scene for --verify: content that scrolls by whole lines, small changes in a corner
+// and changes of the whole panel. The background is opaque, like on a real panel.
+Rectangle {
+    id: root
+    width: 128
+    height: 64
+    color: "white"
+
+    property int tick: 0
+
+    Timer {
+        running: true
+        repeat: true
+        interval: 100
+        onTriggered: root.tick++
+    }
+
+    // moves up one line per tick, hardware scrolling and the start line have to follow it
+    Column {
+        x: 0
+        y: 16 - (root.tick % 48)
+        width: 80
+
+        Repeater {
+            model: 8
+            Rectangle {
+                width: 80
+                height: 8
+                color: (index % 2) ? "black" : "white"
+
+                Rectangle {
+                    x: index * 9
+                    y: 2
+                    width: 8
+                    height: 4
+                    color: (index % 2) ? "white" : "black"
+                }
+            }
+        }
+    }
+
+    // only a few columns change, damage and dirty diffing send just those
+    Text {
+        x: 88
+        y: 2
+        text: root.tick
+        font.pixelSize: 12
+        color: "black"
+    }
+
+    Rectangle {
+        id: bar
+        x: 84
+        y: 20
+        width: 40
+        height: 40
+        border.color: "black"
+        color: "white"
+
+        Rectangle {
+            x: 2
+            y: 38 - height
+            width: 36
+            height: root.tick % 37
+            color: "black"
+        }
+    }
+
+    // every few seconds the whole panel changes at once
+    Rectangle {
+        anchors.fill: parent
+        color: "black"
+        visible: (root.tick % 30) >= 28
+    }
+}